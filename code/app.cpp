@@ -1,24 +1,168 @@
 #include "app.h"
 
+#include "algorithm"
 #include "buffer.h"
+#include "entity_uniform_arena.h"
+#include "filesystem"
+#include "fstream"
+#include "image.h"
+#include "random"
+
+#if __has_include("glslang/build_info.h")
+#include "glslang/build_info.h"
+#endif
+
+namespace {
+#include "built_in_shaders.inl"
+#include "built_in_spirv.inl"
+
+// Frame begin, render pass end and frame copy end.
+constexpr uint32_t kTimestampsPerFrame = 3;
+constexpr VkFormat kFrameFormat = VK_FORMAT_B8G8R8A8_UNORM;
+// Catch-up limit for the fixed timestep after a stall.
+constexpr double kMaxSimulationSteps = 8.0;
+// Smallest batch worth a secondary command buffer of its own.
+constexpr size_t kMinRecordBatch = 32;
+// Longest on-demand sleep, so ShouldClose is still polled without events.
+constexpr double kIdleWaitTimeout = 0.5;
+// On-demand sleep while input is held and may change the state without
+// further events.
+constexpr double kHeldInputWaitTimeout = 1.0 / 240.0;
+// Frames between render scale changes, long enough for the timestamps of
+// frames rendered at the previous scale to drain.
+constexpr uint64_t kRenderScaleInterval = 16;
+// Largest relative render scale change per adjustment.
+constexpr float kMaxRenderScaleStep = 0.1f;
+// The scale only grows while the render pass stays below this fraction of
+// the budget, so it does not oscillate around it.
+constexpr double kRenderScaleHeadroom = 0.8;
+// Hashed into every SPIR-V cache key, so entries compiled by another
+// glslang are never loaded. Bump the revision when the compile options
+// change.
+#ifdef GLSLANG_VERSION_MAJOR
+constexpr uint32_t kShaderCompilerVersion[] = {
+    GLSLANG_VERSION_MAJOR, GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH, 1};
+#else
+constexpr uint32_t kShaderCompilerVersion[] = {0, 0, 0, 1};
+#endif
+constexpr uint32_t kSPIRVMagic = 0x07230203;
+// Words of the SPIR-V header.
+constexpr size_t kSPIRVHeaderWords = 5;
+
+uint64_t Fnv1a(const void *data,
+              size_t size,
+              uint64_t hash = 14695981039346656037ull) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+const char *PresentModeName(VkPresentModeKHR present_mode) {
+  switch (present_mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+      return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return "FIFO_RELAXED";
+    default:
+      return "default";
+  }
+}
+// Views alive with a window, GLFW is terminated with the last one.
+int glfw_users = 0;
+}  // namespace
+
+Application::Application(const ApplicationSettings &settings)
+    : settings_(settings),
+      max_frames_in_flight_(std::max(int(settings.frames_in_flight), 1)),
+      launch_time_(std::chrono::steady_clock::now()) {
+  context_ = settings_.device_context;
+  if (!context_) {
+    context_ = std::make_shared<DeviceContext>(settings_.cache_dir);
+  }
+  if (!settings_.trace_path.empty()) {
+    profiler_ = std::make_unique<Profiler>(settings_.trace_path);
+  }
+  if (settings_.pipelined) {
+    simulation_pool_ = std::make_unique<ThreadPool>(1);
+  }
+  if (settings_.record_threads) {
+    record_pool_ = std::make_unique<ThreadPool>(settings_.record_threads);
+  }
+
+  if (!settings_.replay_path.empty()) {
+    replay_reader_ = std::make_unique<ReplayReader>(settings_.replay_path);
+    seed_ = replay_reader_->Header().seed;
+    settings_.extent = replay_reader_->Header().extent;
+    replay_done_ = replay_reader_->AtEnd();
+    // Replays run as fast as frames can be rendered.
+    settings_.on_demand = false;
+    if (settings_.present_mode == VK_PRESENT_MODE_MAX_ENUM_KHR) {
+      settings_.present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+  } else {
+    seed_ = settings_.seed ? settings_.seed : std::random_device{}();
+  }
+  if (!settings_.record_path.empty()) {
+    replay_writer_ = std::make_unique<ReplayWriter>(
+        settings_.record_path, ReplayHeader{seed_, settings_.extent});
+  }
+
+  if (settings_.headless) {
+    if (!settings_.frame_count && !replay_reader_) {
+      throw std::runtime_error("Headless mode requires a frame count.");
+    }
+    extent_ = settings_.extent;
+    return;
+  }
 
-Application::Application() {
   if (!glfwInit()) {
     throw std::runtime_error("glfwInit failed.");
   }
+  glfw_users++;
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   //  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-  window_ = glfwCreateWindow(1280, 720, "FCG HW6", nullptr, nullptr);
+  window_ = glfwCreateWindow(settings_.extent.width, settings_.extent.height,
+                             settings_.window_title.c_str(), nullptr,
+                             nullptr);
   if (!window_) {
     throw std::runtime_error("glfwCreateWindow failed.");
   }
+
+  glfwSetWindowUserPointer(window_, this);
+  glfwSetKeyCallback(window_, [](GLFWwindow *window, int key, int scancode,
+                                 int action, int mods) {
+    auto app = static_cast<Application *>(glfwGetWindowUserPointer(window));
+    app->pending_events_.push_back(
+        {false, key, scancode, action, mods, 0.0, 0.0});
+  });
+  glfwSetScrollCallback(window_, [](GLFWwindow *window, double xoffset,
+                                    double yoffset) {
+    auto app = static_cast<Application *>(glfwGetWindowUserPointer(window));
+    app->pending_events_.push_back({true, 0, 0, 0, 0, xoffset, yoffset});
+  });
+  glfwSetWindowRefreshCallback(window_, [](GLFWwindow *window) {
+    auto app = static_cast<Application *>(glfwGetWindowUserPointer(window));
+    app->redraw_requested_ = true;
+  });
 }
 
 Application::~Application() {
-  glfwDestroyWindow(window_);
-  glfwTerminate();
+  if (window_) {
+    glfwDestroyWindow(window_);
+  }
+  // Terminating destroys every window, including other views'.
+  if (!settings_.headless && --glfw_users == 0) {
+    glfwTerminate();
+  }
 }
 
 #define THROW_IF_FAILED(x, err_msg)    \
@@ -28,98 +172,548 @@ Application::~Application() {
   }
 
 void Application::Run() {
+  Init();
+  while (Step()) {
+  }
+  Finish();
+}
+
+void Application::Init() {
+  ProfileScope scope(profiler_.get(), "OnInit");
   OnInit();
-  while (!glfwWindowShouldClose(window_)) {
-    OnUpdate();
-    OnRender();
+}
+
+bool Application::Step() {
+  if (ShouldClose()) {
+    return false;
+  }
+  if (!OnUpdate()) {
+    WaitForEvents();
+    return true;
+  }
+  OnRender();
+  if (window_) {
+    ProfileScope scope(profiler_.get(), "PollEvents");
     glfwPollEvents();
   }
+  return true;
+}
+
+void Application::Finish() {
+  if (simulation_.valid()) {
+    simulation_.get();
+  }
   VkResult result;
   THROW_IF_FAILED(device_->WaitIdle(), "Failed to wait for device idle.");
+  CollectLatency();
+  for (int i = 0; i < max_frames_in_flight_; i++) {
+    CollectTimestamps(i);
+    WriteFrameDump(i);
+  }
   OnShutdown();
 }
 
+void RunViews(const std::vector<Application *> &views) {
+  for (auto view : views) {
+    view->Init();
+  }
+  std::vector<Application *> open_views = views;
+  while (!open_views.empty()) {
+    for (size_t i = 0; i < open_views.size();) {
+      if (open_views[i]->Step()) {
+        i++;
+        continue;
+      }
+      open_views[i]->Finish();
+      open_views.erase(open_views.begin() + i);
+    }
+  }
+}
+
+bool Application::ShouldClose() const {
+  if (replay_done_ && !simulation_.valid()) {
+    return true;
+  }
+  if (settings_.frame_count && frame_index_ >= settings_.frame_count) {
+    return true;
+  }
+  return window_ && glfwWindowShouldClose(window_);
+}
+
+bool Application::InputHeld() const {
+  for (auto key : input_state_.keys) {
+    if (key) {
+      return true;
+    }
+  }
+  for (auto button : input_state_.mouse_buttons) {
+    if (button) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Application::WaitForEvents() {
+  ProfileScope scope(profiler_.get(), "WaitEvents");
+  if (InputHeld()) {
+    glfwWaitEventsTimeout(kHeldInputWaitTimeout);
+    return;
+  }
+  glfwWaitEventsTimeout(kIdleWaitTimeout);
+  // Time spent idle is not simulated.
+  last_update_time_ = std::chrono::steady_clock::now();
+}
+
+int Application::GetKey(int key) const {
+  return input_state_.keys[key];
+}
+
+int Application::GetMouseButton(int button) const {
+  return input_state_.mouse_buttons[button];
+}
+
+void Application::GetCursorPos(double *x, double *y) const {
+  *x = input_state_.cursor_x;
+  *y = input_state_.cursor_y;
+}
+
+void Application::SampleInput() {
+  sampled_input_time_ = std::chrono::steady_clock::now();
+  simulation_events_ = std::move(pending_events_);
+  pending_events_.clear();
+  if (!window_) {
+    return;
+  }
+  for (int key = GLFW_KEY_SPACE; key <= GLFW_KEY_LAST; key++) {
+    input_state_.keys[key] = glfwGetKey(window_, key);
+  }
+  for (int button = 0; button <= GLFW_MOUSE_BUTTON_LAST; button++) {
+    input_state_.mouse_buttons[button] = glfwGetMouseButton(window_, button);
+  }
+  glfwGetCursorPos(window_, &input_state_.cursor_x, &input_state_.cursor_y);
+}
+
+void Application::AdvanceClock() {
+  auto now = std::chrono::steady_clock::now();
+  double elapsed =
+      std::chrono::duration<double>(now - last_update_time_).count();
+  last_update_time_ = now;
+  if (settings_.frame_timestep > 0.0) {
+    delta_time_ = float(settings_.frame_timestep);
+    simulation_steps_ = 1;
+    interpolation_alpha_ = 1.0f;
+    return;
+  }
+  if (settings_.fixed_timestep <= 0.0) {
+    delta_time_ = float(elapsed);
+    simulation_steps_ = 1;
+    interpolation_alpha_ = 1.0f;
+    return;
+  }
+  double step = settings_.fixed_timestep;
+  time_accumulator_ =
+      std::min(time_accumulator_ + elapsed, step * kMaxSimulationSteps);
+  simulation_steps_ = uint32_t(time_accumulator_ / step);
+  time_accumulator_ -= simulation_steps_ * step;
+  delta_time_ = float(step);
+  interpolation_alpha_ = float(time_accumulator_ / step);
+}
+
+void Application::SampleFrame() {
+  if (replay_reader_) {
+    ReplayFrame frame;
+    replay_reader_->Read(&frame);
+    replay_done_ = replay_reader_->AtEnd();
+    sampled_input_time_ = std::chrono::steady_clock::now();
+    last_update_time_ = sampled_input_time_;
+    // Live events are dropped, the recorded ones replace them.
+    pending_events_.clear();
+    input_state_ = frame.input;
+    simulation_events_ = std::move(frame.events);
+    delta_time_ = frame.delta_time;
+    simulation_steps_ = frame.simulation_steps;
+    interpolation_alpha_ = frame.interpolation_alpha;
+  } else {
+    SampleInput();
+    AdvanceClock();
+  }
+  if (replay_writer_) {
+    replay_writer_->Write({delta_time_, simulation_steps_,
+                           interpolation_alpha_, input_state_,
+                           simulation_events_});
+  }
+}
+
+void Application::Simulate() {
+  ProfileScope scope(profiler_.get(), "OnUpdateImpl");
+  auto begin = std::chrono::steady_clock::now();
+  dirty_ = false;
+  for (auto &event : simulation_events_) {
+    if (event.scroll) {
+      OnScrollImpl(event.xoffset, event.yoffset);
+    } else {
+      OnKeyImpl(event.key, event.scancode, event.action, event.mods);
+    }
+  }
+  OnUpdateImpl();
+  simulation_ms_ = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+}
+
+void Application::LaunchSimulation() {
+  SampleFrame();
+  simulation_ = simulation_pool_->Submit([this]() { Simulate(); });
+}
+
 void Application::OnInit() {
   CreateDevice();
   CreateSwapchain();
   CreateFrameCommonAssets();
+  CreateTimestampQueries();
+  SelectPresentPath();
+  BuildRenderGraph();
   CreateRenderPass();
   CreateFramebufferAssets();
   CreateDescriptorComponents();
+  uint32_t startup_threads = settings_.startup_threads;
+  if (!startup_threads) {
+    startup_threads = std::thread::hardware_concurrency();
+  }
+  if (startup_threads > 1) {
+    startup_pool_ = std::make_unique<ThreadPool>(startup_threads);
+  }
+  startup_uploads_ = std::make_unique<UploadBatch>(context_.get());
   OnInitImpl();
+  WaitForStartupTasks();
+  WaitForStartupUploads();
+  last_update_time_ = std::chrono::steady_clock::now();
+  replay_begin_time_ = last_update_time_;
+  last_submit_time_ = last_update_time_;
 }
 
 void Application::OnShutdown() {
+  PrintLatency();
+  if (replay_reader_ && settings_.verbose) {
+    double replay_s = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - replay_begin_time_)
+                          .count();
+    fmt::print("Replayed {} frames in {:.2f} s, {:.1f} frames per second.\n",
+               replay_reader_->FrameCount(), replay_s,
+               double(replay_reader_->FrameCount()) / replay_s);
+  }
+  if (replay_writer_ && settings_.verbose) {
+    fmt::print("Recorded {} frames with seed {} to {}.\n",
+               replay_writer_->FrameCount(), seed_, settings_.record_path);
+  }
+  if (dynamic_resolution_ && settings_.verbose) {
+    fmt::print("Dynamic resolution ended at {:.2f} scale, {}x{}.\n",
+               render_scale_, render_extent_.width, render_extent_.height);
+  }
+  if (skipped_transfers_ && settings_.verbose) {
+    fmt::print("Skipped the transfer submit of {} of {} frames.\n",
+               skipped_transfers_, frame_index_);
+  }
+  if (direct_present_ && settings_.verbose) {
+    double saved_bytes = double(FrameCopyBytes()) * double(frame_index_);
+    fmt::print(
+        "Direct present skipped {} frame copies, {:.2f} GiB of traffic.\n",
+        frame_index_, saved_bytes / (1024.0 * 1024.0 * 1024.0));
+  }
   OnShutdownImpl();
   DestroyDescriptorComponents();
   DestroyFramebufferAssets();
+  // The device is idle at this point.
+  for (auto &retired_object : retired_objects_) {
+    retired_object.deleter();
+  }
+  retired_objects_.clear();
   DestroyRenderPass();
+  render_graph_.reset();
+  DestroyTimestampQueries();
   DestroyFrameCommonAssets();
   DestroySwapchain();
   DestroyDevice();
 }
 
-void Application::OnUpdate() {
-  OnUpdateImpl();
+bool Application::OnUpdate() {
+  ProfileScope scope(profiler_.get(), "OnUpdate");
+  CollectLatency();
+  if (simulation_.valid()) {
+    ProfileScope wait_scope(profiler_.get(), "WaitForSimulation");
+    simulation_.get();
+  } else {
+    // Sequential mode, or the first pipelined frame.
+    SampleFrame();
+    Simulate();
+  }
+  if (settings_.on_demand && window_ && !dirty_ && !redraw_requested_) {
+    // Nothing is launched, the next update simulates inline with the input
+    // that woke it up.
+    return false;
+  }
+  redraw_requested_ = false;
+  // The next launch samples input for the following frame.
+  frame_input_time_ = sampled_input_time_;
+  {
+    ProfileScope snapshot_scope(profiler_.get(), "OnSnapshotImpl");
+    auto begin = std::chrono::steady_clock::now();
+    OnSnapshotImpl();
+    current_stats_.update_ms =
+        simulation_ms_ + std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+  }
+  if (simulation_pool_ && !replay_done_) {
+    // Simulate the next frame while this one is recorded and submitted.
+    LaunchSimulation();
+  }
+  WaitForFrame();
+  SubmitTransfer();
+  return true;
+}
+
+void Application::WaitForFrame() {
+  VkFence fence = in_flight_fences_[current_frame_]->Handle();
+  {
+    ProfileScope wait_scope(profiler_.get(), "WaitForFence");
+    vkWaitForFences(device_->Handle(), 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+  CollectLatency();
+  vkResetFences(device_->Handle(), 1, &fence);
+  CollectTimestamps(current_frame_);
+  WriteFrameDump(current_frame_);
+  CollectRetired();
+}
+
+void Application::CollectLatency() {
+  // Scanout is invisible without present timing extensions, so the fence of
+  // the frame, signaled once the presented image is rendered, stands in for
+  // the present. The wait for vblank in FIFO mode is not included. The
+  // sample ends at this poll rather than at the signal, which may be up to
+  // a frame earlier.
+  auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i < int(latency_pending_.size()); i++) {
+    if (!latency_pending_[i] ||
+        vkGetFenceStatus(device_->Handle(), in_flight_fences_[i]->Handle()) !=
+            VK_SUCCESS) {
+      continue;
+    }
+    latency_pending_[i] = false;
+    double latency_ms = std::chrono::duration<double, std::milli>(
+                            now - submitted_input_times_[i])
+                            .count();
+    latency_samples_ms_.push_back(latency_ms);
+    if (settings_.frame_stats) {
+      frame_stats_[stats_indices_[i]].latency_ms = latency_ms;
+    }
+  }
+}
+
+void Application::PrintLatency() const {
+  if (!settings_.verbose || latency_samples_ms_.empty()) {
+    return;
+  }
+  std::vector<double> sorted = latency_samples_ms_;
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0.0;
+  for (double sample : sorted) {
+    sum += sample;
+  }
+  fmt::print(
+      "Input to present latency upper bound ({} present mode, {} frames in "
+      "flight): mean {:.2f} ms, p50 {:.2f} ms, p95 {:.2f} ms, p99 {:.2f} ms "
+      "over {} frames.\n",
+      PresentModeName(present_mode_), max_frames_in_flight_,
+      sum / double(sorted.size()), Percentile(sorted, 0.50),
+      Percentile(sorted, 0.95), Percentile(sorted, 0.99), sorted.size());
+}
+
+void Application::WaitForSubmittedFrames(bool include_current) {
+  std::vector<VkFence> fences;
+  for (int i = 0; i < max_frames_in_flight_; i++) {
+    // The current slot's fence is reset but not yet submitted before EndFrame.
+    if (i != int(current_frame_) || include_current) {
+      fences.push_back(in_flight_fences_[i]->Handle());
+    }
+  }
+  if (!fences.empty()) {
+    ProfileScope wait_scope(profiler_.get(), "WaitForFence");
+    vkWaitForFences(device_->Handle(), fences.size(), fences.data(), VK_TRUE,
+                    UINT64_MAX);
+  }
+}
+
+void Application::RecreateSwapchain(bool include_current) {
+  ProfileScope scope(profiler_.get(), "RecreateSwapchain");
+  // The simulation thread reads FrameExtent().
+  if (simulation_.valid()) {
+    simulation_.wait();
+  }
+  // Only the old swapchain's images have to be idle before it is destroyed,
+  // the transfer queue keeps running and frame assets are retired.
+  WaitForSubmittedFrames(include_current);
+  for (int i = 0; i < max_frames_in_flight_; i++) {
+    if (i != int(current_frame_) || include_current) {
+      WriteFrameDump(i);
+    }
+  }
+  CreateSwapchain();
+  DestroyFramebufferAssets();
+  CreateFramebufferAssets();
+  redraw_requested_ = true;
+}
+
+void Application::Retire(std::function<void()> deleter) {
+  retired_objects_.push_back({frame_index_, std::move(deleter)});
+}
+
+void Application::CollectRetired() {
+  // Frame slots complete in submission order, so after waiting for this
+  // slot's fence every frame up to frame_index_ - max_frames_in_flight_ has
+  // finished.
+  while (!retired_objects_.empty() &&
+         retired_objects_.front().frame_index + max_frames_in_flight_ <=
+             frame_index_) {
+    retired_objects_.front().deleter();
+    retired_objects_.pop_front();
+  }
+}
+
+void Application::SubmitTransfer() {
+  ProfileScope scope(profiler_.get(), "SyncDynamicBuffers");
   VkResult result;
-  THROW_IF_FAILED(vulkan::SingleTimeCommand(
-                      transfer_queue_.get(), transfer_command_pool_.get(),
-                      [&](VkCommandBuffer cmd_buffer) {
-                        for (auto dynamic_buffer : dynamic_buffers_) {
-                          dynamic_buffer->Sync(cmd_buffer);
-                        }
-                      }),
-                  "Failed to execute single time command.")
+  VkCommandBuffer cmd_buffer =
+      transfer_command_buffers_[current_frame_]->Handle();
+  vkResetCommandBuffer(cmd_buffer, 0);
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  THROW_IF_FAILED(vkBeginCommandBuffer(cmd_buffer, &begin_info),
+                  "Failed to begin recording transfer command buffer.")
+  bool recorded = false;
+  for (auto dynamic_buffer : dynamic_buffers_) {
+    recorded = dynamic_buffer->Sync(cmd_buffer) || recorded;
+  }
+  THROW_IF_FAILED(vkEndCommandBuffer(cmd_buffer),
+                  "Failed to record transfer command buffer.")
+  // Direct buffers were written by the host, the render submit has nothing
+  // to wait for.
+  transfer_submitted_ = recorded;
+  if (!recorded) {
+    skipped_transfers_++;
+    return;
+  }
+
+  VkSemaphore transfer_finished_semaphore =
+      transfer_finished_semaphores_[current_frame_]->Handle();
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd_buffer;
+  submit_info.signalSemaphoreCount = 1;
+  submit_info.pSignalSemaphores = &transfer_finished_semaphore;
+  THROW_IF_FAILED(vkQueueSubmit(transfer_queue_->Handle(), 1, &submit_info,
+                                VK_NULL_HANDLE),
+                  "Failed to submit transfer command buffer.")
 }
 
 void Application::OnRender() {
+  ProfileScope scope(profiler_.get(), "OnRender");
   BeginFrame();
 
   VkCommandBuffer cmd_buffer = command_buffers_[current_frame_]->Handle();
 
-  VkImage swapchain_image = swapchain_->Image(image_index_);
+  VkImage swapchain_image =
+      window_ ? swapchain_->Image(image_index_) : VK_NULL_HANDLE;
+  if (direct_present_) {
+    render_graph_->SetImage(frame_color_image_, swapchain_image);
+  } else {
+    render_graph_->SetImage(frame_color_image_, frame_image_->Handle());
+    if (window_) {
+      render_graph_->SetImage(swapchain_image_, swapchain_image);
+    }
+  }
+  render_graph_->SetImage(frame_depth_image_, depth_image_->Handle());
+  render_graph_->Execute(cmd_buffer);
+  WriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2);
 
+  EndFrame();
+}
+
+void Application::RecordScenePass(VkCommandBuffer cmd_buffer) {
   VkClearValue clear_values[2];
   clear_values[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
   clear_values[1].depthStencil = {1.0f, 0};
 
-  VkExtent2D framebuffer_extent = framebuffer_->Extent();
+  vulkan::Framebuffer *framebuffer =
+      direct_present_ ? swapchain_framebuffers_[image_index_].get()
+                      : framebuffer_.get();
 
   VkRenderPassBeginInfo begin_info{};
   begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   begin_info.renderPass = render_pass_->Handle();
-  begin_info.framebuffer = framebuffer_->Handle();
+  begin_info.framebuffer = framebuffer->Handle();
   begin_info.clearValueCount = 2;
   begin_info.pClearValues = clear_values;
   begin_info.renderArea.offset = {0, 0};
-  begin_info.renderArea.extent = framebuffer_extent;
-
-  vkCmdBeginRenderPass(cmd_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-  // Set viewport and scissor
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = framebuffer_extent.width;
-  viewport.height = framebuffer_extent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-  vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
-
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = framebuffer_extent;
-  vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
-
-  OnRenderImpl(cmd_buffer);
+  begin_info.renderArea.extent = render_extent_;
+
+  current_framebuffer_ = framebuffer->Handle();
+  if (record_pool_) {
+    // The subpass only executes secondaries, the main thread records into one
+    // of its own so OnRenderImpl is unaware of the mode.
+    vkCmdBeginRenderPass(cmd_buffer, &begin_info,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    VkCommandBuffer main_cmd_buffer =
+        BeginSecondary(record_contexts_[current_frame_].back());
+    frame_secondaries_.push_back(main_cmd_buffer);
+    {
+      ProfileScope impl_scope(profiler_.get(), "OnRenderImpl");
+      OnRenderImpl(main_cmd_buffer);
+    }
+    VkResult result;
+    THROW_IF_FAILED(vkEndCommandBuffer(frame_secondaries_.back()),
+                    "Failed to record secondary command buffer.")
+    vkCmdExecuteCommands(cmd_buffer, frame_secondaries_.size(),
+                         frame_secondaries_.data());
+    frame_secondaries_.clear();
+  } else {
+    vkCmdBeginRenderPass(cmd_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    SetViewportAndScissor(cmd_buffer);
+    {
+      ProfileScope impl_scope(profiler_.get(), "OnRenderImpl");
+      OnRenderImpl(cmd_buffer);
+    }
+  }
 
   vkCmdEndRenderPass(cmd_buffer);
+  WriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+}
 
-  vulkan::TransitImageLayout(
-      cmd_buffer, swapchain_image, VK_IMAGE_LAYOUT_UNDEFINED,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
-      VK_IMAGE_ASPECT_COLOR_BIT);
+void Application::RecordPresentCopy(VkCommandBuffer cmd_buffer) {
+  VkImage swapchain_image = swapchain_->Image(image_index_);
+  if (dynamic_resolution_) {
+    // Upscale the rendered region to the whole swapchain image.
+    VkImageBlit blit_region{};
+    blit_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit_region.srcSubresource.layerCount = 1;
+    blit_region.srcOffsets[1] = {int32_t(render_extent_.width),
+                                 int32_t(render_extent_.height), 1};
+    blit_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit_region.dstSubresource.layerCount = 1;
+    blit_region.dstOffsets[1] = {int32_t(extent_.width),
+                                 int32_t(extent_.height), 1};
+
+    vkCmdBlitImage(cmd_buffer, frame_image_->Handle(),
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit_region,
+                   VK_FILTER_LINEAR);
+    return;
+  }
 
   VkImageCopy copy_region{};
   copy_region.srcOffset = {};
@@ -128,52 +722,62 @@ void Application::OnRender() {
   copy_region.srcSubresource.layerCount = 1;
   copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   copy_region.dstSubresource.layerCount = 1;
-  copy_region.extent.width = framebuffer_->Extent().width;
-  copy_region.extent.height = framebuffer_->Extent().height;
+  copy_region.extent.width = extent_.width;
+  copy_region.extent.height = extent_.height;
   copy_region.extent.depth = 1;
 
   vkCmdCopyImage(cmd_buffer, frame_image_->Handle(),
                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image,
                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+}
 
-  vulkan::TransitImageLayout(
-      cmd_buffer, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT,
-      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
-      VK_IMAGE_ASPECT_COLOR_BIT);
-
-  EndFrame();
+void Application::RecordFrameReadback(VkCommandBuffer cmd_buffer) {
+  if (frame_index_ % settings_.dump_interval != 0) {
+    return;
+  }
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {extent_.width, extent_.height, 1};
+  vkCmdCopyImageToBuffer(cmd_buffer, frame_image_->Handle(),
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         readback_buffers_[current_frame_]->Handle(), 1,
+                         &region);
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = readback_buffers_[current_frame_]->Handle();
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier,
+                       0, nullptr);
+  pending_dumps_[current_frame_] = int64_t(frame_index_);
 }
 
 void Application::CreateDevice() {
   VkResult result;
 
-  vulkan::InstanceCreateHint instance_create_hint;
-  THROW_IF_FAILED(vulkan::CreateInstance(instance_create_hint, &instance_),
-                  "Failed to create vulkan instance.")
-
-  THROW_IF_FAILED(instance_->CreateSurfaceFromGLFWWindow(window_, &surface_),
-                  "Failed to create surface for current glfw window.")
-
-  vulkan::DeviceFeatureRequirement feature_requirement;
-  feature_requirement.surface = surface_.get();
-
-  THROW_IF_FAILED(instance_->CreateDevice(feature_requirement, &device_),
-                  "Failed to create vulkan logical device.")
-
-  THROW_IF_FAILED(
-      device_->GetQueue(device_->PhysicalDevice().GraphicsFamilyIndex(), 0,
-                        &graphics_queue_),
-      "Failed to get graphics queue.")
-  THROW_IF_FAILED(
-      device_->GetQueue(device_->PhysicalDevice().TransferFamilyIndex(), -1,
-                        &transfer_queue_),
-      "Failed to get transfer queue.")
-  THROW_IF_FAILED(
-      device_->GetQueue(
-          device_->PhysicalDevice().PresentFamilyIndex(surface_.get()), 0,
-          &present_queue_),
-      "Failed to get present queue.")
+  if (window_) {
+    THROW_IF_FAILED(
+        context_->Instance()->CreateSurfaceFromGLFWWindow(window_, &surface_),
+        "Failed to create surface for current glfw window.")
+  }
+  context_->CreateDevice(surface_.get());
+  device_ = context_->Device();
+  graphics_queue_ = context_->GraphicsQueue();
+  transfer_queue_ = context_->TransferQueue();
+  if (surface_) {
+    THROW_IF_FAILED(
+        device_->GetQueue(
+            device_->PhysicalDevice().PresentFamilyIndex(surface_.get()), 0,
+            &present_queue_),
+        "Failed to get present queue.")
+  }
 
   THROW_IF_FAILED(device_->CreateCommandPool(
                       device_->PhysicalDevice().GraphicsFamilyIndex(),
@@ -195,15 +799,41 @@ void Application::DestroyDevice() {
   graphics_queue_.reset();
   device_.reset();
   surface_.reset();
-  instance_.reset();
 }
 
 void Application::CreateSwapchain() {
   swapchain_.reset();
+  if (!surface_) {
+    extent_ = settings_.extent;
+    return;
+  }
 
   VkResult result;
-  THROW_IF_FAILED(device_->CreateSwapchain(surface_.get(), &swapchain_),
-                  "Failed to create swapchain.");
+  if (settings_.present_mode == VK_PRESENT_MODE_MAX_ENUM_KHR) {
+    THROW_IF_FAILED(device_->CreateSwapchain(surface_.get(), &swapchain_),
+                    "Failed to create swapchain.");
+    extent_ = swapchain_->Extent();
+    return;
+  }
+
+  VkPhysicalDevice physical_device = device_->PhysicalDevice().Handle();
+  uint32_t mode_count = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(
+      physical_device, surface_->Handle(), &mode_count, nullptr);
+  std::vector<VkPresentModeKHR> modes(mode_count);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(
+      physical_device, surface_->Handle(), &mode_count, modes.data());
+  present_mode_ = settings_.present_mode;
+  if (std::find(modes.begin(), modes.end(), present_mode_) == modes.end()) {
+    // FIFO is the only mode every surface has to support.
+    fmt::print("{} present mode is not supported, using FIFO.\n",
+               PresentModeName(present_mode_));
+    present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
+  }
+  THROW_IF_FAILED(
+      device_->CreateSwapchain(surface_.get(), present_mode_, &swapchain_),
+      "Failed to create swapchain.");
+  extent_ = swapchain_->Extent();
 }
 
 void Application::DestroySwapchain() {
@@ -216,6 +846,11 @@ void Application::CreateFrameCommonAssets() {
   render_finished_semaphores_.resize(max_frames_in_flight_);
   image_available_semaphores_.resize(max_frames_in_flight_);
   in_flight_fences_.resize(max_frames_in_flight_);
+  transfer_command_buffers_.resize(max_frames_in_flight_);
+  transfer_finished_semaphores_.resize(max_frames_in_flight_);
+  submitted_input_times_.resize(max_frames_in_flight_);
+  latency_pending_.assign(max_frames_in_flight_, false);
+  stats_indices_.assign(max_frames_in_flight_, 0);
 
   for (int i = 0; i < max_frames_in_flight_; i++) {
     THROW_IF_FAILED(
@@ -227,6 +862,26 @@ void Application::CreateFrameCommonAssets() {
                     "Failed to create image available semaphore.")
     THROW_IF_FAILED(device_->CreateFence(true, &in_flight_fences_[i]),
                     "Failed to create in flight fence.")
+    THROW_IF_FAILED(transfer_command_pool_->AllocateCommandBuffer(
+                        &transfer_command_buffers_[i]),
+                    "Failed to create transfer command buffer.")
+    THROW_IF_FAILED(
+        device_->CreateSemaphore(&transfer_finished_semaphores_[i]),
+        "Failed to create transfer finished semaphore.")
+  }
+
+  if (record_pool_) {
+    record_contexts_.resize(max_frames_in_flight_);
+    for (auto &frame_contexts : record_contexts_) {
+      frame_contexts.resize(record_pool_->ThreadCount() + 1);
+      for (auto &context : frame_contexts) {
+        THROW_IF_FAILED(
+            device_->CreateCommandPool(
+                device_->PhysicalDevice().GraphicsFamilyIndex(),
+                VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &context.command_pool),
+            "Failed to create record command pool.")
+      }
+    }
   }
 }
 
@@ -235,6 +890,65 @@ void Application::DestroyFrameCommonAssets() {
   render_finished_semaphores_.clear();
   image_available_semaphores_.clear();
   in_flight_fences_.clear();
+  transfer_command_buffers_.clear();
+  transfer_finished_semaphores_.clear();
+  submitted_input_times_.clear();
+  latency_pending_.clear();
+  stats_indices_.clear();
+  record_contexts_.clear();
+}
+
+void Application::BuildRenderGraph() {
+  render_graph_ = std::make_unique<RenderGraph>();
+  if (direct_present_) {
+    // Chains onto the acquire semaphore wait.
+    frame_color_image_ = render_graph_->AddExternalImage(
+        "swapchain", VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  } else {
+    frame_color_image_ =
+        render_graph_->AddTransientImage("frame", VK_IMAGE_ASPECT_COLOR_BIT);
+    if (window_) {
+      swapchain_image_ = render_graph_->AddExternalImage(
+          "swapchain", VK_IMAGE_ASPECT_COLOR_BIT,
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
+  }
+  frame_depth_image_ =
+      render_graph_->AddTransientImage("depth", VK_IMAGE_ASPECT_DEPTH_BIT);
+
+  scene_pass_added_ = false;
+  OnBuildRenderGraphImpl(render_graph_.get());
+  if (!scene_pass_added_) {
+    throw std::runtime_error("The render graph has no scene pass.");
+  }
+
+  if (window_ && !direct_present_) {
+    render_graph_->AddPass(
+        "PresentCopy",
+        {{frame_color_image_, ImageUsage::kTransferSrc},
+         {swapchain_image_, ImageUsage::kTransferDst}},
+        [this](VkCommandBuffer cmd_buffer) { RecordPresentCopy(cmd_buffer); });
+  }
+  if (settings_.dump_interval) {
+    render_graph_->AddPass("FrameReadback",
+                           {{frame_color_image_, ImageUsage::kTransferSrc}},
+                           [this](VkCommandBuffer cmd_buffer) {
+                             RecordFrameReadback(cmd_buffer);
+                           });
+  }
+  render_graph_->Compile();
+}
+
+void Application::AddScenePass(RenderGraph *graph) {
+  scene_pass_ = graph->AddPass(
+      "Scene",
+      {{frame_color_image_, ImageUsage::kColorAttachment},
+       {frame_depth_image_, ImageUsage::kDepthAttachment}},
+      [this](VkCommandBuffer cmd_buffer) { RecordScenePass(cmd_buffer); });
+  scene_pass_added_ = true;
 }
 
 void Application::CreateRenderPass() {
@@ -243,13 +957,17 @@ void Application::CreateRenderPass() {
   VkAttachmentDescription color_attachment_description;
   VkAttachmentDescription depth_attachment_description;
 
-  color_attachment_description.format = VK_FORMAT_B8G8R8A8_UNORM;
+  // The render graph transitions the attachments around the pass.
+  color_attachment_description.format = kFrameFormat;
   color_attachment_description.flags = 0;
-  color_attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  color_attachment_description.initialLayout =
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
   color_attachment_description.finalLayout =
-      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-  color_attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  color_attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  color_attachment_description.loadOp =
+      render_graph_->LoadOp(scene_pass_, frame_color_image_);
+  color_attachment_description.storeOp =
+      render_graph_->StoreOp(scene_pass_, frame_color_image_);
   color_attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   color_attachment_description.stencilStoreOp =
       VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -257,11 +975,14 @@ void Application::CreateRenderPass() {
 
   depth_attachment_description.format = VK_FORMAT_D32_SFLOAT;
   depth_attachment_description.flags = 0;
-  depth_attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depth_attachment_description.initialLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
   depth_attachment_description.finalLayout =
       VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-  depth_attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depth_attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depth_attachment_description.loadOp =
+      render_graph_->LoadOp(scene_pass_, frame_depth_image_);
+  depth_attachment_description.storeOp =
+      render_graph_->StoreOp(scene_pass_, frame_depth_image_);
   depth_attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depth_attachment_description.stencilStoreOp =
       VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -287,46 +1008,122 @@ void Application::DestroyRenderPass() {
   render_pass_.reset();
 }
 
+void Application::SelectPresentPath() {
+  direct_present_ = false;
+  dynamic_resolution_ = false;
+  if (settings_.frame_budget_ms > 0.0 && swapchain_ &&
+      timestamp_query_pool_ != VK_NULL_HANDLE && !settings_.dump_interval) {
+    // The reduced resolution frame is upscaled into the swapchain image, so
+    // it needs the private frame image.
+    dynamic_resolution_ = true;
+    render_scale_ = settings_.max_render_scale;
+    if (settings_.verbose) {
+      fmt::print("Dynamic resolution holds the render pass within {:.2f} ms, "
+                 "scaling between {:.2f} and {:.2f}.\n",
+                 settings_.frame_budget_ms, settings_.min_render_scale,
+                 settings_.max_render_scale);
+    }
+    return;
+  }
+  if (!settings_.direct_present || !swapchain_) {
+    return;
+  }
+  if (swapchain_->Format() != kFrameFormat) {
+    fmt::print("Swapchain format {} differs from the frame format, presenting "
+               "through a frame image copy.\n",
+               int(swapchain_->Format()));
+    return;
+  }
+  if (settings_.dump_interval) {
+    // Frame dumps read back the private frame image.
+    return;
+  }
+  direct_present_ = true;
+  if (!settings_.verbose) {
+    return;
+  }
+  fmt::print("Rendering directly into swapchain images, saving {:.2f} MiB of "
+             "copy traffic per frame at {}x{}.\n",
+             double(FrameCopyBytes()) / (1024.0 * 1024.0), extent_.width,
+             extent_.height);
+}
+
+uint64_t Application::FrameCopyBytes() const {
+  // The copy reads the frame image and writes the swapchain image.
+  return uint64_t(extent_.width) * extent_.height * 4 * 2;
+}
+
 void Application::CreateFramebufferAssets() {
   VkResult result;
-  THROW_IF_FAILED(device_->CreateImage(VK_FORMAT_B8G8R8A8_UNORM,
-                                       swapchain_->Extent(), &frame_image_),
-                  "Failed to create frame image.")
   THROW_IF_FAILED(
-      device_->CreateImage(VK_FORMAT_D32_SFLOAT, swapchain_->Extent(),
-                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+      device_->CreateImage(VK_FORMAT_D32_SFLOAT, extent_,
+                           render_graph_->UsageFlags(frame_depth_image_),
                            VK_IMAGE_ASPECT_DEPTH_BIT, &depth_image_),
       "Failed to create depth image.")
+
+  if (direct_present_) {
+    if (swapchain_->Format() != kFrameFormat) {
+      throw std::runtime_error("Swapchain format changed on recreation.");
+    }
+    swapchain_framebuffers_.resize(swapchain_->ImageCount());
+    for (uint32_t i = 0; i < swapchain_->ImageCount(); i++) {
+      THROW_IF_FAILED(
+          render_pass_->CreateFramebuffer(
+              {swapchain_->ImageView(i), depth_image_->ImageView()}, extent_,
+              &swapchain_framebuffers_[i]),
+          "Failed to create swapchain framebuffer.")
+    }
+    return;
+  }
+
+  THROW_IF_FAILED(
+      device_->CreateImage(kFrameFormat, extent_,
+                           render_graph_->UsageFlags(frame_color_image_),
+                           VK_IMAGE_ASPECT_COLOR_BIT, &frame_image_),
+      "Failed to create frame image.")
   THROW_IF_FAILED(render_pass_->CreateFramebuffer(
                       {frame_image_->ImageView(), depth_image_->ImageView()},
-                      swapchain_->Extent(), &framebuffer_),
+                      extent_, &framebuffer_),
                   "Failed to create framebuffer.")
+
+  if (settings_.dump_interval) {
+    readback_buffers_.resize(max_frames_in_flight_);
+    pending_dumps_.resize(max_frames_in_flight_, -1);
+    for (auto &readback_buffer : readback_buffers_) {
+      THROW_IF_FAILED(
+          device_->CreateBuffer(
+              VkDeviceSize(extent_.width) * extent_.height * 4,
+              VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU,
+              &readback_buffer),
+          "Failed to create frame readback buffer.")
+    }
+  }
 }
 
 void Application::DestroyFramebufferAssets() {
-  framebuffer_.reset();
-  frame_image_.reset();
-  depth_image_.reset();
+  for (auto &readback_buffer : readback_buffers_) {
+    Retire(std::move(readback_buffer));
+  }
+  readback_buffers_.clear();
+  pending_dumps_.clear();
+  for (auto &framebuffer : swapchain_framebuffers_) {
+    Retire(std::move(framebuffer));
+  }
+  swapchain_framebuffers_.clear();
+  Retire(std::move(framebuffer_));
+  Retire(std::move(frame_image_));
+  Retire(std::move(depth_image_));
 }
 
 void Application::CreateDescriptorComponents() {
   VkResult result;
 
-  THROW_IF_FAILED(
-      device_->CreateSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR,
-                             VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-                             VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-                             VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, false,
-                             VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
-                             VK_SAMPLER_MIPMAP_MODE_LINEAR, &entity_sampler_),
-      "Failed to create entity sampler.")
-
-  VkSampler sampler = entity_sampler_->Handle();
+  VkSampler sampler = context_->EntitySampler()->Handle();
   THROW_IF_FAILED(
       device_->CreateDescriptorSetLayout(
           {{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
             VK_SHADER_STAGE_FRAGMENT_BIT, &sampler},
-           {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
+           {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
             VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
             nullptr}},
           &entity_descriptor_set_layout_),
@@ -339,38 +1136,41 @@ void Application::CreateDescriptorComponents() {
                       pool_size.ToVkDescriptorPoolSize(),
                       max_frames_in_flight_ * 1024, &entity_descriptor_pool_),
                   "Failed to create entity descriptor pool.")
+  entity_uniforms_ =
+      std::make_unique<EntityUniformArena>(this, settings_.max_entities);
 }
 
 void Application::DestroyDescriptorComponents() {
-  entity_descriptor_pool_.reset();
+  entity_uniforms_.reset();
+  // Sets of entities destroyed in OnShutdownImpl are still retired.
+  Retire(std::move(entity_descriptor_pool_));
   entity_descriptor_set_layout_.reset();
-  entity_sampler_.reset();
 }
 
 void Application::BeginFrame() {
+  ProfileScope scope(profiler_.get(), "BeginFrame");
   VkResult result;
-  VkFence fence = in_flight_fences_[current_frame_]->Handle();
-  vkWaitForFences(device_->Handle(), 1, &fence, VK_TRUE, UINT64_MAX);
-  vkResetFences(device_->Handle(), 1, &fence);
 
   if (window_) {
+    ProfileScope acquire_scope(profiler_.get(), "AcquireNextImage");
     VkSemaphore image_available_semaphore =
         image_available_semaphores_[current_frame_]->Handle();
-    result = swapchain_->AcquireNextImage(std::numeric_limits<uint64_t>::max(),
-                                          image_available_semaphore,
-                                          VK_NULL_HANDLE, &image_index_);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-      // Recreate swapchain
-      THROW_IF_FAILED(device_->WaitIdle(),
-                      "Failed to wait for device idle, on swapchain recreate.");
-      CreateSwapchain();
-      DestroyFramebufferAssets();
-      CreateFramebufferAssets();
-      return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+    while (true) {
+      result = swapchain_->AcquireNextImage(
+          std::numeric_limits<uint64_t>::max(), image_available_semaphore,
+          VK_NULL_HANDLE, &image_index_);
+      if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+        break;
+      }
+      // Recreate swapchain, the transfer for this frame is already submitted
+      // so the frame has to be rendered on the new one.
+      RecreateSwapchain(false);
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
       throw std::runtime_error("Failed to acquire next image.");
     }
   }
+  UpdateRenderExtent();
 
   VkCommandBuffer command_buffer = command_buffers_[current_frame_]->Handle();
 
@@ -382,41 +1182,89 @@ void Application::BeginFrame() {
 
   THROW_IF_FAILED(vkBeginCommandBuffer(command_buffer, &begin_info),
                   "Failed to begin recording command buffer.")
+
+  if (record_pool_) {
+    // The frame's fence has been waited, its secondaries are free to reuse.
+    for (auto &context : record_contexts_[current_frame_]) {
+      vkResetCommandPool(device_->Handle(), context.command_pool->Handle(), 0);
+      context.used = 0;
+    }
+  }
+
+  if (timestamp_query_pool_ != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(command_buffer, timestamp_query_pool_,
+                        current_frame_ * kTimestampsPerFrame,
+                        kTimestampsPerFrame);
+  }
+  WriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+  record_begin_time_ = std::chrono::steady_clock::now();
 }
 
 void Application::EndFrame() {
+  ProfileScope scope(profiler_.get(), "EndFrame");
   VkResult result;
   VkCommandBuffer command_buffer = command_buffers_[current_frame_]->Handle();
   THROW_IF_FAILED(vkEndCommandBuffer(command_buffer),
                   "Failed to record command buffer.")
+  current_stats_.record_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() -
+                                 record_begin_time_)
+                                 .count();
 
-  VkSemaphore image_available_semaphore =
-      image_available_semaphores_[current_frame_]->Handle();
   VkSemaphore render_finished_semaphore =
       render_finished_semaphores_[current_frame_]->Handle();
 
   VkFence fence = in_flight_fences_[current_frame_]->Handle();
-  VkPipelineStageFlags wait_stages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+  VkSemaphore wait_semaphores[2];
+  VkPipelineStageFlags wait_stages[2];
+  uint32_t wait_count = 0;
+  if (transfer_submitted_) {
+    wait_semaphores[wait_count] =
+        transfer_finished_semaphores_[current_frame_]->Handle();
+    wait_stages[wait_count++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  }
+  if (window_) {
+    wait_semaphores[wait_count] =
+        image_available_semaphores_[current_frame_]->Handle();
+    wait_stages[wait_count++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  }
 
   VkSubmitInfo submit_info{};
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.waitSemaphoreCount = wait_count;
+  submit_info.pWaitSemaphores = wait_semaphores;
   submit_info.pWaitDstStageMask = wait_stages;
   submit_info.commandBufferCount = 1;
   submit_info.pCommandBuffers = &command_buffer;
 
   if (window_) {
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &image_available_semaphore;
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = &render_finished_semaphore;
   }
 
-  THROW_IF_FAILED(
-      vkQueueSubmit(graphics_queue_->Handle(), 1, &submit_info, fence),
-      "Failed to submit command buffer.")
+  {
+    ProfileScope submit_scope(profiler_.get(), "QueueSubmit");
+    THROW_IF_FAILED(
+        vkQueueSubmit(graphics_queue_->Handle(), 1, &submit_info, fence),
+        "Failed to submit command buffer.")
+  }
+  if (timestamp_query_pool_ != VK_NULL_HANDLE) {
+    timestamps_pending_[current_frame_] = true;
+  }
+  submitted_input_times_[current_frame_] = frame_input_time_;
+  latency_pending_[current_frame_] = true;
+  if (settings_.frame_stats) {
+    auto now = std::chrono::steady_clock::now();
+    current_stats_.frame_ms =
+        std::chrono::duration<double, std::milli>(now - last_submit_time_)
+            .count();
+    last_submit_time_ = now;
+    stats_indices_[current_frame_] = frame_stats_.size();
+    frame_stats_.push_back(current_stats_);
+  }
 
   if (window_) {
+    ProfileScope present_scope(profiler_.get(), "QueuePresent");
     VkSwapchainKHR swapchain = swapchain_->Handle();
     VkPresentInfoKHR present_info{};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -428,17 +1276,401 @@ void Application::EndFrame() {
 
     result = vkQueuePresentKHR(present_queue_->Handle(), &present_info);
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-      THROW_IF_FAILED(device_->WaitIdle(),
-                      "Failed to wait for device idle, on swapchain recreate.");
-      CreateSwapchain();
-      DestroyFramebufferAssets();
-      CreateFramebufferAssets();
+      RecreateSwapchain(true);
     } else if (result != VK_SUCCESS) {
       throw std::runtime_error("Failed to present image.");
     }
   }
 
+  if (frame_index_ == 0 && settings_.verbose) {
+    fmt::print(
+        "First frame submitted {:.1f} ms after launch, {} start (SPIR-V cache "
+        "{} hits, {} misses, {} built-in shaders).\n",
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - launch_time_)
+            .count(),
+        context_->PipelineCacheWarm() ? "warm" : "cold",
+        shader_cache_hits_.load(), shader_cache_misses_.load(),
+        shader_built_in_.load());
+  }
+
   current_frame_ = (current_frame_ + 1) % max_frames_in_flight_;
+  frame_index_++;
+}
+
+void Application::WriteFrameDump(uint32_t frame) {
+  if (frame >= pending_dumps_.size() || pending_dumps_[frame] < 0) {
+    return;
+  }
+  Image image(extent_.width, extent_.height);
+  auto readback_buffer = readback_buffers_[frame].get();
+  auto data = static_cast<const uint8_t *>(readback_buffer->Map());
+  // The frame image is B8G8R8A8, Image stores RGBA.
+  for (size_t i = 0; i < image.Pixels().size(); i++) {
+    image.Pixels()[i] = {data[i * 4 + 2], data[i * 4 + 1], data[i * 4],
+                         data[i * 4 + 3]};
+  }
+  readback_buffer->Unmap();
+  image.WriteToFile(fmt::format(settings_.dump_path, pending_dumps_[frame]));
+  pending_dumps_[frame] = -1;
+}
+
+void Application::CreateTimestampQueries() {
+  if (!profiler_ && !settings_.frame_stats &&
+      settings_.frame_budget_ms <= 0.0) {
+    return;
+  }
+
+  VkPhysicalDevice physical_device = device_->PhysicalDevice().Handle();
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  uint32_t family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                           families.data());
+  uint32_t valid_bits =
+      families[device_->PhysicalDevice().GraphicsFamilyIndex()]
+          .timestampValidBits;
+  if (!valid_bits || properties.limits.timestampPeriod == 0.0f) {
+    // No GPU zones on this queue, the trace only gets CPU zones.
+    return;
+  }
+  timestamp_period_ns_ = properties.limits.timestampPeriod;
+  timestamp_mask_ = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+  VkResult result;
+  VkQueryPoolCreateInfo create_info{};
+  create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  create_info.queryCount = max_frames_in_flight_ * kTimestampsPerFrame;
+  THROW_IF_FAILED(vkCreateQueryPool(device_->Handle(), &create_info, nullptr,
+                                    &timestamp_query_pool_),
+                  "Failed to create timestamp query pool.")
+  timestamps_pending_.assign(max_frames_in_flight_, false);
+  if (!profiler_) {
+    return;
+  }
+
+  // Map GPU ticks onto the profiler clock with one round trip.
+  double begin_us = profiler_->NowUs();
+  THROW_IF_FAILED(
+      vulkan::SingleTimeCommand(
+          graphics_queue_.get(), graphics_command_pool_.get(),
+          [&](VkCommandBuffer cmd_buffer) {
+            vkCmdResetQueryPool(cmd_buffer, timestamp_query_pool_, 0, 1);
+            vkCmdWriteTimestamp(cmd_buffer,
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                timestamp_query_pool_, 0);
+          }),
+      "Failed to calibrate GPU timestamps.")
+  double end_us = profiler_->NowUs();
+  uint64_t timestamp = 0;
+  THROW_IF_FAILED(
+      vkGetQueryPoolResults(device_->Handle(), timestamp_query_pool_, 0, 1,
+                            sizeof(timestamp), &timestamp, sizeof(timestamp),
+                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT),
+      "Failed to read calibration timestamp.")
+  gpu_time_offset_us_ = (begin_us + end_us) * 0.5 -
+                        double(timestamp & timestamp_mask_) *
+                            timestamp_period_ns_ * 1e-3;
+}
+
+void Application::DestroyTimestampQueries() {
+  if (timestamp_query_pool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device_->Handle(), timestamp_query_pool_, nullptr);
+    timestamp_query_pool_ = VK_NULL_HANDLE;
+  }
+  timestamps_pending_.clear();
+}
+
+void Application::WriteTimestamp(VkCommandBuffer cmd_buffer,
+                                 VkPipelineStageFlagBits stage,
+                                 uint32_t query) {
+  if (timestamp_query_pool_ == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdWriteTimestamp(cmd_buffer, stage, timestamp_query_pool_,
+                      current_frame_ * kTimestampsPerFrame + query);
+}
+
+void Application::CollectTimestamps(uint32_t frame) {
+  if (timestamp_query_pool_ == VK_NULL_HANDLE ||
+      !timestamps_pending_[frame]) {
+    return;
+  }
+  timestamps_pending_[frame] = false;
+
+  uint64_t timestamps[kTimestampsPerFrame];
+  if (vkGetQueryPoolResults(device_->Handle(), timestamp_query_pool_,
+                            frame * kTimestampsPerFrame, kTimestampsPerFrame,
+                            sizeof(timestamps), timestamps, sizeof(uint64_t),
+                            VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return;
+  }
+  auto to_us = [this](uint64_t timestamp) {
+    return double(timestamp & timestamp_mask_) * timestamp_period_ns_ * 1e-3 +
+           gpu_time_offset_us_;
+  };
+  if (dynamic_resolution_) {
+    AdjustRenderScale((to_us(timestamps[1]) - to_us(timestamps[0])) * 1e-3);
+  }
+  if (settings_.frame_stats) {
+    frame_stats_[stats_indices_[frame]].gpu_ms =
+        (to_us(timestamps[2]) - to_us(timestamps[0])) * 1e-3;
+  }
+  if (profiler_) {
+    profiler_->AddGpuEvent("RenderPass", to_us(timestamps[0]),
+                           to_us(timestamps[1]));
+    profiler_->AddGpuEvent("FrameCopy", to_us(timestamps[1]),
+                           to_us(timestamps[2]));
+  }
+}
+
+void Application::AdjustRenderScale(double render_pass_ms) {
+  render_pass_ms_ = render_pass_ms_ > 0.0
+                        ? render_pass_ms_ * 0.9 + render_pass_ms * 0.1
+                        : render_pass_ms;
+  if (frame_index_ < last_scale_frame_ + kRenderScaleInterval) {
+    return;
+  }
+  double budget = settings_.frame_budget_ms;
+  if (render_pass_ms_ <= budget &&
+      render_pass_ms_ >= budget * kRenderScaleHeadroom) {
+    return;
+  }
+  // Fragment cost follows the pixel count, the square of the scale. Aim at
+  // the middle of the band.
+  double target = budget * (1.0 + kRenderScaleHeadroom) * 0.5;
+  float scale = render_scale_ * float(std::sqrt(target / render_pass_ms_));
+  scale = std::clamp(scale, render_scale_ * (1.0f - kMaxRenderScaleStep),
+                     render_scale_ * (1.0f + kMaxRenderScaleStep));
+  render_scale_ = std::clamp(scale, settings_.min_render_scale,
+                             settings_.max_render_scale);
+  render_pass_ms_ = 0.0;
+  last_scale_frame_ = frame_index_;
+}
+
+void Application::UpdateRenderExtent() {
+  if (!dynamic_resolution_) {
+    render_extent_ = extent_;
+    return;
+  }
+  render_extent_.width =
+      std::max(uint32_t(float(extent_.width) * render_scale_), 1u);
+  render_extent_.height =
+      std::max(uint32_t(float(extent_.height) * render_scale_), 1u);
+}
+
+VkCommandBuffer Application::RecordInParallel(
+    VkCommandBuffer cmd_buffer,
+    size_t count,
+    const std::function<void(VkCommandBuffer, size_t, size_t)> &fn) {
+  size_t batch_count = 0;
+  if (record_pool_) {
+    batch_count =
+        std::min<size_t>(record_pool_->ThreadCount(), count / kMinRecordBatch);
+  }
+  if (batch_count <= 1) {
+    fn(cmd_buffer, 0, count);
+    return cmd_buffer;
+  }
+
+  // Close the main thread's secondary so the batches execute after it.
+  VkResult result;
+  THROW_IF_FAILED(vkEndCommandBuffer(cmd_buffer),
+                  "Failed to record secondary command buffer.")
+  auto &contexts = record_contexts_[current_frame_];
+  std::vector<std::future<VkCommandBuffer>> batches;
+  for (size_t batch = 0; batch < batch_count; batch++) {
+    size_t begin = count * batch / batch_count;
+    size_t end = count * (batch + 1) / batch_count;
+    RecordContext *context = &contexts[batch];
+    batches.push_back(record_pool_->Submit([this, context, &fn, begin, end]() {
+      ProfileScope scope(profiler_.get(), "RecordBatch");
+      VkCommandBuffer batch_cmd_buffer = BeginSecondary(*context);
+      fn(batch_cmd_buffer, begin, end);
+      VkResult result;
+      THROW_IF_FAILED(vkEndCommandBuffer(batch_cmd_buffer),
+                      "Failed to record secondary command buffer.")
+      return batch_cmd_buffer;
+    }));
+  }
+  for (auto &batch : batches) {
+    batch.wait();
+  }
+  for (auto &batch : batches) {
+    frame_secondaries_.push_back(batch.get());
+  }
+
+  cmd_buffer = BeginSecondary(contexts.back());
+  frame_secondaries_.push_back(cmd_buffer);
+  return cmd_buffer;
+}
+
+VkCommandBuffer Application::BeginSecondary(RecordContext &context) {
+  VkResult result;
+  if (context.used == context.command_buffers.size()) {
+    VkCommandBufferAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = context.command_pool->Handle();
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocate_info.commandBufferCount = 1;
+    VkCommandBuffer cmd_buffer;
+    THROW_IF_FAILED(vkAllocateCommandBuffers(device_->Handle(), &allocate_info,
+                                             &cmd_buffer),
+                    "Failed to allocate secondary command buffer.")
+    context.command_buffers.push_back(cmd_buffer);
+  }
+  VkCommandBuffer cmd_buffer = context.command_buffers[context.used++];
+
+  VkCommandBufferInheritanceInfo inheritance_info{};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass = render_pass_->Handle();
+  inheritance_info.subpass = 0;
+  inheritance_info.framebuffer = current_framebuffer_;
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                     VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance_info;
+  THROW_IF_FAILED(vkBeginCommandBuffer(cmd_buffer, &begin_info),
+                  "Failed to begin secondary command buffer.")
+  SetViewportAndScissor(cmd_buffer);
+  return cmd_buffer;
+}
+
+void Application::SetViewportAndScissor(VkCommandBuffer cmd_buffer) const {
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = render_extent_.width;
+  viewport.height = render_extent_.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = render_extent_;
+  vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+}
+
+std::vector<uint32_t> Application::CompileShader(const std::string &path,
+                                                 VkShaderStageFlagBits stage) {
+  std::vector<uint32_t> built_in = GetShaderSPIRV(path);
+  if (!built_in.empty()) {
+    // Never compiled nor read from the cache directory, so neither a hit
+    // nor a miss.
+    shader_built_in_++;
+    return built_in;
+  }
+
+  std::string source = GetShaderCode(path);
+  if (settings_.cache_dir.empty()) {
+    return vulkan::CompileGLSLToSPIRV(source, stage);
+  }
+
+  uint64_t hash = Fnv1a(source.data(), source.size());
+  hash = Fnv1a(&stage, sizeof(stage), hash);
+  hash = Fnv1a(kShaderCompilerVersion, sizeof(kShaderCompilerVersion), hash);
+  std::filesystem::path cache_path =
+      std::filesystem::path(settings_.cache_dir) /
+      fmt::format("{:016x}.spv", hash);
+
+  // Truncated or foreign entries count as misses and are overwritten.
+  std::vector<uint8_t> data;
+  if (ReadBinaryFile(cache_path, &data) &&
+      data.size() >= kSPIRVHeaderWords * sizeof(uint32_t) &&
+      data.size() % sizeof(uint32_t) == 0) {
+    std::vector<uint32_t> spirv(data.size() / sizeof(uint32_t));
+    std::memcpy(spirv.data(), data.data(), data.size());
+    if (spirv[0] == kSPIRVMagic) {
+      shader_cache_hits_++;
+      return spirv;
+    }
+  }
+
+  shader_cache_misses_++;
+  std::vector<uint32_t> spirv = vulkan::CompileGLSLToSPIRV(source, stage);
+  WriteBinaryFile(cache_path, spirv.data(), spirv.size() * sizeof(uint32_t));
+  return spirv;
+}
+
+StartupTask Application::RunAtStartup(std::function<void()> fn,
+                                      std::vector<StartupTask> dependencies) {
+  if (!startup_pool_) {
+    for (auto &dependency : dependencies) {
+      dependency.get();
+    }
+    fn();
+    std::promise<void> done;
+    done.set_value();
+    return done.get_future().share();
+  }
+  // Dependencies were queued earlier and the queue is FIFO, so every one of
+  // them is running or finished by the time this task waits on it.
+  StartupTask task =
+      startup_pool_
+          ->Submit([fn = std::move(fn),
+                    dependencies = std::move(dependencies)]() {
+            for (auto &dependency : dependencies) {
+              dependency.get();
+            }
+            fn();
+          })
+          .share();
+  startup_tasks_.push_back(task);
+  return task;
+}
+
+void Application::WaitForStartupUploads() {
+  auto begin_time = std::chrono::steady_clock::now();
+  {
+    ProfileScope scope(profiler_.get(), "WaitForStartupUploads");
+    startup_uploads_->Submit();
+    startup_uploads_->Wait();
+  }
+  if (startup_uploads_->UploadCount() && settings_.verbose) {
+    fmt::print("{} startup uploads of {:.2f} MiB in one submit, waited {:.1f} "
+               "ms for it.\n",
+               startup_uploads_->UploadCount(),
+               double(startup_uploads_->StagedBytes()) / (1 << 20),
+               std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - begin_time)
+                   .count());
+  }
+  startup_uploads_.reset();
+}
+
+void Application::WaitForStartupTasks() {
+  if (!startup_pool_) {
+    return;
+  }
+  auto begin_time = std::chrono::steady_clock::now();
+  {
+    ProfileScope scope(profiler_.get(), "WaitForStartupTasks");
+    // Everything finishes before a failure is rethrown, no task outlives
+    // the objects it writes to.
+    for (auto &task : startup_tasks_) {
+      task.wait();
+    }
+  }
+  if (settings_.verbose) {
+    fmt::print("{} startup tasks on {} threads, waited {:.1f} ms for them.\n",
+               startup_tasks_.size(), startup_pool_->ThreadCount(),
+               std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - begin_time)
+                   .count());
+  }
+  startup_pool_.reset();
+  auto tasks = std::move(startup_tasks_);
+  startup_tasks_.clear();
+  for (auto &task : tasks) {
+    task.get();
+  }
 }
 
 void Application::RegisterDynamicBuffer(DynamicBufferBase *buffer) {
@@ -1,16 +1,144 @@
 #pragma once
+#include "array"
+#include "atomic"
+#include "deque"
+#include "device_context.h"
+#include "functional"
+#include "future"
 #include "glm/glm.hpp"
+#include "profiler.h"
+#include "render_graph.h"
+#include "replay.h"
+#include "stdexcept"
+#include "thread_pool.h"
+#include "upload_batch.h"
 #include "utils.h"
 
+class EntityUniformArena;
+
+struct ApplicationSettings {
+  // Render into the offscreen frame image without creating a window, surface
+  // or swapchain.
+  bool headless{false};
+  std::string window_title{"FCG HW6"};
+  // Frame extent in headless mode, and the initial window size otherwise.
+  VkExtent2D extent{1280, 720};
+  // Stop after this many frames, 0 runs until the window is closed.
+  uint64_t frame_count{0};
+  // Read back every Nth frame and write it to dump_path, 0 disables dumps.
+  uint64_t dump_interval{0};
+  // fmt pattern, formatted with the frame index.
+  std::string dump_path{"frame_{:05}.png"};
+  // Write CPU zones and GPU timestamps as a Chrome trace, empty disables.
+  std::string trace_path;
+  // Render straight into swapchain images when their format matches the
+  // frame format, falling back to copying the private frame image.
+  bool direct_present{true};
+  // Write small dynamic buffers straight into host visible device local
+  // memory when the device has it, instead of copying them from staging
+  // buffers on the transfer queue.
+  bool direct_dynamic_buffers{true};
+  // Simulate frame N + 1 on a worker thread while frame N is recorded.
+  bool pipelined{false};
+  // Advance the simulation in steps of this many seconds and interpolate the
+  // rendered state, 0 runs one step per frame with the elapsed time.
+  double fixed_timestep{0.0};
+  // Worker threads recording secondary command buffers for
+  // RecordInParallel, 0 records everything inline on the main thread.
+  uint32_t record_threads{0};
+  // Directory for compiled SPIR-V and the serialized pipeline cache, empty
+  // disables both.
+  std::string cache_dir{"cache"};
+  // FIFO, MAILBOX or IMMEDIATE, falling back to FIFO when the surface does
+  // not support it. VK_PRESENT_MODE_MAX_ENUM_KHR keeps LongMarch's choice.
+  VkPresentModeKHR present_mode{VK_PRESENT_MODE_MAX_ENUM_KHR};
+  // Frames the CPU may record ahead of the GPU. Fewer frames lower input
+  // latency at the cost of CPU/GPU overlap.
+  uint32_t frames_in_flight{3};
+  // Advance the simulation by exactly this many seconds every frame,
+  // ignoring the wall clock, so runs are reproducible. Overrides
+  // fixed_timestep when set.
+  double frame_timestep{0.0};
+  // Keep per-frame timings, see FrameStatistics().
+  bool frame_stats{false};
+  // Print which render paths were chosen and how they fared, silent
+  // otherwise.
+  bool verbose{false};
+  // Scale the render resolution so the GPU render pass holds this many
+  // milliseconds, upscaling to the swapchain with a blit. 0 disables.
+  double frame_budget_ms{0.0};
+  // Bounds of the render resolution scale, per axis.
+  float min_render_scale{0.5f};
+  float max_render_scale{1.0f};
+  // Only render after updates that called MarkDirty or when the window needs
+  // repainting, otherwise sleep until the next event. Ignored when headless.
+  bool on_demand{false};
+  // Threads compiling shaders and creating pipelines during OnInitImpl, 0
+  // uses every hardware thread and 1 creates everything inline.
+  uint32_t startup_threads{0};
+  // Log every simulated frame's timestep and input to this file, empty
+  // disables recording.
+  std::string record_path;
+  // Simulate the frames logged in this file instead of the clock and input,
+  // rendering each as soon as the previous one is, and stop after the last.
+  // The recorded seed and extent replace the settings'.
+  std::string replay_path;
+  // Seed returned by Application::Seed(), 0 picks a random one.
+  uint32_t seed{0};
+  // Entities that can exist at once, each takes a slot of the entity
+  // uniform arena.
+  uint32_t max_entities{1024};
+  // Device, queues and caches shared with the other views in the process,
+  // each application creates its own when null. cache_dir only picks the
+  // pipeline cache file of a context created here.
+  std::shared_ptr<DeviceContext> device_context;
+};
+
+struct FrameStats {
+  // Wall time since the previous submit.
+  double frame_ms{};
+  // OnUpdateImpl and OnSnapshotImpl.
+  double update_ms{};
+  // From the acquired image to the end of the primary command buffer.
+  double record_ms{};
+  // First to last timestamp of the frame, negative when the graphics queue
+  // has no timestamps.
+  double gpu_ms{-1.0};
+  // From the input sample to the first fence poll that saw the frame
+  // rendered. Fences are only polled at frame boundaries, so this is an
+  // upper bound of input-to-present latency, by up to a frame. Negative
+  // until the frame is collected.
+  double latency_ms{-1.0};
+};
+
+// Completion of a task started with Application::RunAtStartup.
+using StartupTask = std::shared_future<void>;
+
 class Application {
  public:
-  Application();
-  ~Application();
+  explicit Application(const ApplicationSettings &settings = {});
+  virtual ~Application();
   void Run();
 
+  // Run split up, so several views can be driven from one loop. Step
+  // updates and renders one frame and returns false once the view should
+  // close, Finish is called after the last Step.
+  void Init();
+  bool Step();
+  void Finish();
+
   [[nodiscard]] uint32_t MaxFramesInFlight() const {
     return max_frames_in_flight_;
   }
+  [[nodiscard]] DeviceContext *Context() const {
+    return context_.get();
+  }
+  // Textures from image files, shared by every view of the context.
+  [[nodiscard]] std::shared_ptr<TextureImage> LoadTexture(
+      const std::string &path,
+      UploadBatch *batch = nullptr) const {
+    return context_->LoadTexture(path, batch);
+  }
   [[nodiscard]] const vulkan::Device *Device() const {
     return device_.get();
   }
@@ -36,39 +164,214 @@ class Application {
   [[nodiscard]] const vulkan::DescriptorPool *EntityDescriptorPool() const {
     return entity_descriptor_pool_.get();
   }
+  // Whether DynamicBufferPolicy::kAuto picks the direct path.
+  [[nodiscard]] bool DirectDynamicBuffers() const {
+    return settings_.direct_dynamic_buffers &&
+           context_->HostVisibleDeviceLocal();
+  }
+  [[nodiscard]] EntityUniformArena *EntityUniforms() const {
+    return entity_uniforms_.get();
+  }
   [[nodiscard]] const vulkan::Swapchain *Swapchain() const {
     return swapchain_.get();
   }
   [[nodiscard]] const vulkan::Sampler *EntitySampler() const {
-    return entity_sampler_.get();
+    return context_->EntitySampler();
   }
   [[nodiscard]] GLFWwindow *Window() const {
     return window_;
   }
+  [[nodiscard]] bool Headless() const {
+    return settings_.headless;
+  }
+  [[nodiscard]] VkExtent2D FrameExtent() const {
+    return extent_;
+  }
+  // Region of the frame rendered this frame, smaller than FrameExtent() under
+  // dynamic resolution. Viewport and scissor already cover it.
+  [[nodiscard]] VkExtent2D RenderExtent() const {
+    return render_extent_;
+  }
   [[nodiscard]] uint32_t CurrentFrame() const {
     return current_frame_;
   }
+  [[nodiscard]] uint64_t FrameIndex() const {
+    return frame_index_;
+  }
+  [[nodiscard]] Profiler *GetProfiler() const {
+    return profiler_.get();
+  }
+  // One entry per submitted frame when frame_stats is set. GPU times are
+  // complete once Run has returned.
+  [[nodiscard]] const std::vector<FrameStats> &FrameStatistics() const {
+    return frame_stats_;
+  }
+
+  // Simulation timing, valid inside OnUpdateImpl. The state is advanced
+  // SimulationSteps() times by DeltaTime() and drawn InterpolationAlpha() of
+  // the way from the second to last step to the last one.
+  [[nodiscard]] float DeltaTime() const {
+    return delta_time_;
+  }
+  [[nodiscard]] uint32_t SimulationSteps() const {
+    return simulation_steps_;
+  }
+  [[nodiscard]] float InterpolationAlpha() const {
+    return interpolation_alpha_;
+  }
+  // Seed for every random number the simulation draws, so recorded runs
+  // replay identically.
+  [[nodiscard]] uint32_t Seed() const {
+    return seed_;
+  }
+  // Call from OnUpdateImpl or the input handlers when the rendered state
+  // changed. Updates that do not call it skip rendering in on-demand mode.
+  void MarkDirty() {
+    dirty_ = true;
+  }
+
+  // Input queries, sampled once per simulated frame. These report no input
+  // in headless mode unless replaying.
+  [[nodiscard]] int GetKey(int key) const;
+  [[nodiscard]] int GetMouseButton(int button) const;
+  void GetCursorPos(double *x, double *y) const;
+
+  // Returns the SPIR-V embedded at build time, or compiles the built-in
+  // source, reusing SPIR-V from the cache directory when the source and stage
+  // hash matches.
+  [[nodiscard]] std::vector<uint32_t> CompileShader(
+      const std::string &path,
+      VkShaderStageFlagBits stage);
+
+  // Creates a graphics pipeline through the persistent pipeline cache.
+  template <class PipelinePtr>
+  VkResult CreateGraphicsPipeline(const vulkan::PipelineSettings &settings,
+                                  PipelinePtr pp_pipeline) const {
+    return device_->CreatePipeline(settings, context_->PipelineCache(),
+                                   pp_pipeline);
+  }
+
+  // Runs fn on the startup threads once every dependency has finished, so
+  // independent shaders and pipelines are created concurrently. Only call
+  // from the main thread. Outside OnInitImpl, or with a single startup
+  // thread, fn runs inline. OnInit waits for every task after OnInitImpl
+  // and rethrows the first failure.
+  StartupTask RunAtStartup(std::function<void()> fn,
+                           std::vector<StartupTask> dependencies = {});
+
+  // Collects the uploads of OnInitImpl, OnInit submits it once after the
+  // startup tasks and waits for it. Null outside OnInitImpl.
+  [[nodiscard]] UploadBatch *StartupUploads() const {
+    return startup_uploads_.get();
+  }
+
+  // Compiles the shader and creates its module as a startup task, which
+  // fails when the module cannot be created.
+  template <class ModulePtr>
+  StartupTask CreateShaderModuleAsync(const std::string &path,
+                                      VkShaderStageFlagBits stage,
+                                      ModulePtr pp_module) {
+    return RunAtStartup([this, path, stage, pp_module]() {
+      if (device_->CreateShaderModule(CompileShader(path, stage),
+                                      pp_module) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shader module " + path +
+                                 ".");
+      }
+    });
+  }
+
+  // Adds the pass that begins the frame's render pass and calls
+  // OnRenderImpl. Only valid inside OnBuildRenderGraphImpl.
+  void AddScenePass(RenderGraph *graph);
+  // The images the scene pass renders into, for passes declared around it.
+  [[nodiscard]] RenderGraph::ImageId FrameColorImage() const {
+    return frame_color_image_;
+  }
+  [[nodiscard]] RenderGraph::ImageId FrameDepthImage() const {
+    return frame_depth_image_;
+  }
+
+  // Call from OnRenderImpl. Splits count items into batches recorded by
+  // fn(cmd_buffer, begin, end) on the record threads, each into its own
+  // secondary command buffer that starts with only viewport and scissor set.
+  // Returns the command buffer the caller continues recording into.
+  VkCommandBuffer RecordInParallel(
+      VkCommandBuffer cmd_buffer,
+      size_t count,
+      const std::function<void(VkCommandBuffer, size_t, size_t)> &fn);
 
   void RegisterDynamicBuffer(DynamicBufferBase *buffer);
   void UnregisterDynamicBuffer(DynamicBufferBase *buffer);
 
+  // Defers a deleter until every frame recorded up to now has completed on
+  // the GPU. The retired object must not be recorded again after this call.
+  void Retire(std::function<void()> deleter);
+  template <class T>
+  void Retire(std::unique_ptr<T> object) {
+    if (object) {
+      Retire([object = std::shared_ptr<T>(std::move(object))]() mutable {
+        object.reset();
+      });
+    }
+  }
+  template <class T>
+  void Retire(std::shared_ptr<T> object) {
+    if (object) {
+      Retire([object = std::move(object)]() mutable { object.reset(); });
+    }
+  }
+
  private:
   void OnInit();
-  void OnUpdate();
+  // Returns false when on-demand mode skips rendering this frame.
+  [[nodiscard]] bool OnUpdate();
   void OnRender();
   void OnShutdown();
 
   virtual void OnInitImpl() = 0;
   virtual void OnShutdownImpl() = 0;
+  // Runs on the simulation thread in pipelined mode, together with the key
+  // and scroll handlers. It must not touch GPU objects or dynamic buffers.
   virtual void OnUpdateImpl() = 0;
+  // Runs on the main thread once OnUpdateImpl has finished, publishes the
+  // simulated state to dynamic buffers and whatever OnRenderImpl reads.
+  virtual void OnSnapshotImpl() {
+  }
   virtual void OnRenderImpl(VkCommandBuffer cmd_buffer) = 0;
+  // Declares the frame's passes once at startup, before OnInitImpl. Passes
+  // added before the scene pass run before it, e.g. a depth prepass, and
+  // passes added after it read its results, e.g. post-processing.
+  virtual void OnBuildRenderGraphImpl(RenderGraph *graph) {
+    AddScenePass(graph);
+  }
+  virtual void OnKeyImpl(int key, int scancode, int action, int mods) {
+  }
+  virtual void OnScrollImpl(double xoffset, double yoffset) {
+  }
+
+  void SampleInput();
+  void AdvanceClock();
+  // Samples input and the clock, or reads them from the replay, and logs
+  // them when recording.
+  void SampleFrame();
+  void Simulate();
+  void LaunchSimulation();
+
+  [[nodiscard]] bool ShouldClose() const;
+  [[nodiscard]] bool InputHeld() const;
+  void WaitForEvents();
 
   void CreateDevice();
   void CreateSwapchain();
+  void SelectPresentPath();
+  void BuildRenderGraph();
   void CreateFrameCommonAssets();
   void CreateRenderPass();
   void CreateFramebufferAssets();
   void CreateDescriptorComponents();
+  void CreateTimestampQueries();
+  void WaitForStartupTasks();
+  void WaitForStartupUploads();
 
   void DestroyDevice();
   void DestroySwapchain();
@@ -76,15 +379,48 @@ class Application {
   void DestroyRenderPass();
   void DestroyFramebufferAssets();
   void DestroyDescriptorComponents();
+  void DestroyTimestampQueries();
+
+  void WriteTimestamp(VkCommandBuffer cmd_buffer,
+                      VkPipelineStageFlagBits stage,
+                      uint32_t query);
+  void CollectTimestamps(uint32_t frame);
+  void AdjustRenderScale(double render_pass_ms);
+  void UpdateRenderExtent();
+
+  struct RecordContext {
+    std::unique_ptr<vulkan::CommandPool> command_pool;
+    std::vector<VkCommandBuffer> command_buffers;
+    size_t used{};
+  };
+  void RecordScenePass(VkCommandBuffer cmd_buffer);
+  void RecordPresentCopy(VkCommandBuffer cmd_buffer);
+  void RecordFrameReadback(VkCommandBuffer cmd_buffer);
 
+  VkCommandBuffer BeginSecondary(RecordContext &context);
+  void SetViewportAndScissor(VkCommandBuffer cmd_buffer) const;
+
+  void WaitForFrame();
+  void CollectLatency();
+  void PrintLatency() const;
+  void WaitForSubmittedFrames(bool include_current);
+  void RecreateSwapchain(bool include_current);
+  void CollectRetired();
+  void SubmitTransfer();
   void BeginFrame();
   void EndFrame();
 
+  void WriteFrameDump(uint32_t frame);
+  [[nodiscard]] uint64_t FrameCopyBytes() const;
+
+  ApplicationSettings settings_;
   GLFWwindow *window_{};
+  VkExtent2D extent_{};
 
   int max_frames_in_flight_{3};
+  VkPresentModeKHR present_mode_{VK_PRESENT_MODE_MAX_ENUM_KHR};
 
-  std::shared_ptr<vulkan::Instance> instance_;
+  std::shared_ptr<DeviceContext> context_;
   std::shared_ptr<vulkan::Surface> surface_;
   std::shared_ptr<vulkan::Device> device_;
 
@@ -105,17 +441,121 @@ class Application {
       render_finished_semaphores_;
   std::vector<std::shared_ptr<long_march::vulkan::Fence>> in_flight_fences_;
 
+  std::vector<std::shared_ptr<vulkan::CommandBuffer>> transfer_command_buffers_;
+  std::vector<std::shared_ptr<long_march::vulkan::Semaphore>>
+      transfer_finished_semaphores_;
+  // Whether this frame's transfer was submitted, the render waits for it.
+  bool transfer_submitted_{false};
+  uint64_t skipped_transfers_{};
+
   std::shared_ptr<vulkan::Image> frame_image_;
   std::shared_ptr<vulkan::Image> depth_image_;
   std::shared_ptr<vulkan::RenderPass> render_pass_;
   std::shared_ptr<vulkan::Framebuffer> framebuffer_;
+  std::vector<std::shared_ptr<vulkan::Framebuffer>> swapchain_framebuffers_;
+  bool direct_present_{false};
+
+  std::unique_ptr<RenderGraph> render_graph_;
+  RenderGraph::ImageId frame_color_image_{};
+  RenderGraph::ImageId frame_depth_image_{};
+  RenderGraph::ImageId swapchain_image_{};
+  uint32_t scene_pass_{};
+  bool scene_pass_added_{false};
+
+  VkExtent2D render_extent_{};
+  bool dynamic_resolution_{false};
+  float render_scale_{1.0f};
+  // Smoothed render pass time at the current scale, 0 before any sample.
+  double render_pass_ms_{};
+  uint64_t last_scale_frame_{};
+
+  std::vector<std::unique_ptr<vulkan::Buffer>> readback_buffers_;
+  std::vector<int64_t> pending_dumps_;
+
+  struct RetiredObject {
+    uint64_t frame_index;
+    std::function<void()> deleter;
+  };
+  std::deque<RetiredObject> retired_objects_;
 
   uint32_t current_frame_{};
   uint32_t image_index_{};
+  uint64_t frame_index_{};
 
   std::set<DynamicBufferBase *> dynamic_buffers_;
 
-  std::unique_ptr<vulkan::Sampler> entity_sampler_;
+  std::unique_ptr<Profiler> profiler_;
+
+  InputState input_state_;
+  // Queued by the GLFW callbacks and handed to the next simulated frame.
+  std::vector<InputEvent> pending_events_;
+  std::vector<InputEvent> simulation_events_;
+
+  // Input-to-present latency. The input sampled for a frame is matched to
+  // the frame's fence, polled at frame boundaries until it signals, so the
+  // samples are upper bounds.
+  std::chrono::steady_clock::time_point sampled_input_time_;
+  std::chrono::steady_clock::time_point frame_input_time_;
+  std::vector<std::chrono::steady_clock::time_point> submitted_input_times_;
+  std::vector<bool> latency_pending_;
+  std::vector<double> latency_samples_ms_;
+
+  std::vector<FrameStats> frame_stats_;
+  FrameStats current_stats_;
+  double simulation_ms_{};
+  std::chrono::steady_clock::time_point record_begin_time_;
+  std::chrono::steady_clock::time_point last_submit_time_;
+  // Index into frame_stats_ of the frame last submitted from each slot.
+  std::vector<size_t> stats_indices_;
+
+  std::chrono::steady_clock::time_point last_update_time_;
+  double time_accumulator_{};
+  float delta_time_{};
+  uint32_t simulation_steps_{1};
+  float interpolation_alpha_{1.0f};
+
+  // Written by the simulation, read once it has finished.
+  bool dirty_{false};
+  // Set when the presented image is stale regardless of the simulation.
+  bool redraw_requested_{true};
+
+  std::unique_ptr<ThreadPool> simulation_pool_;
+
+  std::chrono::steady_clock::time_point launch_time_;
+  std::atomic<uint32_t> shader_cache_hits_{0};
+  std::atomic<uint32_t> shader_cache_misses_{0};
+  std::atomic<uint32_t> shader_built_in_{0};
+
+  uint32_t seed_{};
+  std::unique_ptr<ReplayWriter> replay_writer_;
+  std::unique_ptr<ReplayReader> replay_reader_;
+  // Set once the last recorded frame has been sampled.
+  bool replay_done_{false};
+  std::chrono::steady_clock::time_point replay_begin_time_;
+
+  std::unique_ptr<ThreadPool> startup_pool_;
+  std::vector<StartupTask> startup_tasks_;
+  std::unique_ptr<UploadBatch> startup_uploads_;
+
+  std::unique_ptr<ThreadPool> record_pool_;
+  // Per frame in flight, one context per record thread plus one for the main
+  // thread at the back.
+  std::vector<std::vector<RecordContext>> record_contexts_;
+  std::vector<VkCommandBuffer> frame_secondaries_;
+  VkFramebuffer current_framebuffer_{VK_NULL_HANDLE};
+  std::future<void> simulation_;
+  VkQueryPool timestamp_query_pool_{VK_NULL_HANDLE};
+  std::vector<bool> timestamps_pending_;
+  double timestamp_period_ns_{};
+  uint64_t timestamp_mask_{};
+  double gpu_time_offset_us_{};
+
   std::unique_ptr<vulkan::DescriptorSetLayout> entity_descriptor_set_layout_;
   std::unique_ptr<vulkan::DescriptorPool> entity_descriptor_pool_;
+  std::unique_ptr<EntityUniformArena> entity_uniforms_;
 };
+
+// Drives several views sharing a device context from one loop until every
+// one of them has closed. A view sleeping in on-demand mode stalls the
+// others, so views run here should not use it.
+void RunViews(const std::vector<Application *> &views);
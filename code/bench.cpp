@@ -0,0 +1,138 @@
+#include "algorithm"
+#include "bezier.h"
+#include "fstream"
+#include "lighting.h"
+#include "snow.h"
+#include "solar_system.h"
+#include "spiral.h"
+
+namespace {
+struct Demo {
+  const char *name;
+  std::function<std::unique_ptr<Application>(const ApplicationSettings &)>
+      create;
+};
+
+template <class DemoApp>
+Demo MakeDemo(const char *name) {
+  return {name, [](const ApplicationSettings &settings) {
+            return std::make_unique<DemoApp>(settings);
+          }};
+}
+
+std::string FormatDemo(const std::vector<FrameStats> &stats,
+                       uint64_t warmup) {
+  std::vector<double> frame_ms, update_ms, record_ms, gpu_ms, latency_ms;
+  double total_ms = 0.0;
+  for (size_t i = warmup; i < stats.size(); i++) {
+    frame_ms.push_back(stats[i].frame_ms);
+    update_ms.push_back(stats[i].update_ms);
+    record_ms.push_back(stats[i].record_ms);
+    gpu_ms.push_back(stats[i].gpu_ms);
+    latency_ms.push_back(stats[i].latency_ms);
+    total_ms += stats[i].frame_ms;
+  }
+  double fps = total_ms > 0.0 ? double(frame_ms.size()) * 1000.0 / total_ms
+                              : 0.0;
+  return fmt::format(
+      "{{\n      \"frames\": {},\n      \"fps\": {:.2f},\n"
+      "      \"frame_ms\": {},\n      \"update_ms\": {},\n"
+      "      \"record_ms\": {},\n      \"gpu_ms\": {},\n"
+      "      \"latency_ms\": {}\n    }}",
+      frame_ms.size(), fps, SeriesToJson(frame_ms), SeriesToJson(update_ms),
+      SeriesToJson(record_ms), SeriesToJson(gpu_ms), SeriesToJson(latency_ms));
+}
+}  // namespace
+
+// Runs every demo headless for a fixed number of frames with a fixed
+// simulated timestep and writes frame time percentiles as JSON.
+int main(int argc, char **argv) {
+  ApplicationSettings settings;
+  settings.headless = true;
+  settings.frame_count = 600;
+  settings.frame_timestep = 1.0 / 60.0;
+  settings.frame_stats = true;
+  uint64_t warmup = 60;
+  std::string output = "bench.json";
+  std::vector<std::string> only;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--demo") {
+      only.push_back(next());
+    } else if (arg == "--width") {
+      settings.extent.width = std::stoul(next());
+    } else if (arg == "--height") {
+      settings.extent.height = std::stoul(next());
+    } else if (arg == "--frames") {
+      settings.frame_count = std::stoull(next());
+    } else if (arg == "--warmup") {
+      warmup = std::stoull(next());
+    } else if (arg == "--dt") {
+      settings.frame_timestep = std::stod(next());
+    } else if (arg == "--output") {
+      output = next();
+    } else if (arg == "--pipelined") {
+      settings.pipelined = true;
+    } else if (arg == "--record-threads") {
+      settings.record_threads = std::stoul(next());
+    } else if (arg == "--frames-in-flight") {
+      settings.frames_in_flight = std::stoul(next());
+    } else if (arg == "--cache-dir") {
+      settings.cache_dir = next();
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+  if (warmup >= settings.frame_count) {
+    throw std::runtime_error("Warmup must be shorter than the run.");
+  }
+
+  std::vector<Demo> demos = {
+      MakeDemo<Lighting>("lighting"), MakeDemo<SolarSystem>("solar_system"),
+      MakeDemo<Bezier>("bezier"), MakeDemo<SnowSystem>("snow"),
+      MakeDemo<SpiralSystem>("spiral")};
+
+  std::vector<std::string> results;
+  for (auto &demo : demos) {
+    if (!only.empty() &&
+        std::find(only.begin(), only.end(), demo.name) == only.end()) {
+      continue;
+    }
+    fmt::print("Benchmarking {}...\n", demo.name);
+    std::vector<FrameStats> stats;
+    {
+      auto app = demo.create(settings);
+      app->Run();
+      stats = app->FrameStatistics();
+    }
+    results.push_back(
+        fmt::format("    \"{}\": {}", demo.name, FormatDemo(stats, warmup)));
+  }
+
+  std::string json = fmt::format(
+      "{{\n  \"frames\": {},\n  \"warmup\": {},\n  \"dt\": {},\n"
+      "  \"extent\": [{}, {}],\n  \"pipelined\": {},\n"
+      "  \"record_threads\": {},\n"
+      "  \"latency_ms_bound\": \"upper, input sample to the first fence "
+      "poll seeing the frame rendered\",\n  \"demos\": {{\n",
+      settings.frame_count, warmup, settings.frame_timestep,
+      settings.extent.width, settings.extent.height, settings.pipelined,
+      settings.record_threads);
+  for (size_t i = 0; i < results.size(); i++) {
+    json += results[i] + (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  json += "  }\n}\n";
+
+  std::ofstream file(output);
+  if (!file) {
+    throw std::runtime_error("Failed to open " + output);
+  }
+  file << json;
+  fmt::print("Wrote {}\n", output);
+}
@@ -4,17 +4,21 @@
 #include "random"
 
 namespace {
-#include "built_in_shaders.inl"
-}
+// Pipeline variant key bits.
+constexpr uint64_t kWireframeVariant = 1 << 0;
+constexpr uint64_t kTexturedVariant = 1 << 1;
+
+// Specialization constant ids of bezier.frag and bezier.tese.
+constexpr uint32_t kTexturedConstant = 0;
+constexpr uint32_t kDegreeConstant = 1;
+
+// The control point grid holds patches up to degree 4.
+constexpr int32_t kBezierDegree = 4;
+}  // namespace
 
-Bezier::Bezier() {
+Bezier::Bezier(const ApplicationSettings &settings)
+    : Application(settings), random_(Seed()) {
   RandomizeControlPoints();
-  glfwSetKeyCallback(Window(), [](GLFWwindow *window, int key, int scancode,
-                                  int action, int mods) {
-    auto app = reinterpret_cast<Bezier *>(glfwGetWindowUserPointer(window));
-    app->OnKey(key, scancode, action, mods);
-  });
-  glfwSetWindowUserPointer(Window(), this);
 }
 
 void Bezier::OnInitImpl() {
@@ -30,48 +34,54 @@ void Bezier::OnShutdownImpl() {
 }
 
 void Bezier::OnUpdateImpl() {
-  static auto last_time = std::chrono::high_resolution_clock::now();
-  auto current_time = std::chrono::high_resolution_clock::now();
-  float duration_s = std::chrono::duration<float, std::chrono::seconds::period>(
-                         current_time - last_time)
-                         .count();
-  last_time = current_time;
-  if (glfwGetKey(Window(), GLFW_KEY_A) == GLFW_PRESS) {
-    rotation_phi_ += 0.5f * duration_s;
-  }
-  if (glfwGetKey(Window(), GLFW_KEY_D) == GLFW_PRESS) {
-    rotation_phi_ -= 0.5f * duration_s;
-  }
-  if (glfwGetKey(Window(), GLFW_KEY_W) == GLFW_PRESS) {
-    rotation_theta_ -= 0.5f * duration_s;
-  }
-  if (glfwGetKey(Window(), GLFW_KEY_S) == GLFW_PRESS) {
-    rotation_theta_ += 0.5f * duration_s;
-  }
-  while (rotation_phi_ > 2 * glm::pi<float>()) {
-    rotation_phi_ -= 2 * glm::pi<float>();
-  }
-  while (rotation_phi_ < 0.0f) {
-    rotation_phi_ += 2 * glm::pi<float>();
-  }
-  if (rotation_theta_ > glm::pi<float>() - 1e-3f) {
-    rotation_theta_ = glm::pi<float>() - 1e-3f;
-  } else if (rotation_theta_ < 1e-3f) {
-    rotation_theta_ = 1e-3f;
+  BezierGlobalUniformObject last_global_uniform_object =
+      global_uniform_object_;
+  float delta_t = DeltaTime();
+  for (uint32_t step = 0; step < SimulationSteps(); step++) {
+    float last_phi = rotation_phi_;
+    float last_theta = rotation_theta_;
+    if (GetKey(GLFW_KEY_A) == GLFW_PRESS) {
+      rotation_phi_ += 0.5f * delta_t;
+    }
+    if (GetKey(GLFW_KEY_D) == GLFW_PRESS) {
+      rotation_phi_ -= 0.5f * delta_t;
+    }
+    if (GetKey(GLFW_KEY_W) == GLFW_PRESS) {
+      rotation_theta_ -= 0.5f * delta_t;
+    }
+    if (GetKey(GLFW_KEY_S) == GLFW_PRESS) {
+      rotation_theta_ += 0.5f * delta_t;
+    }
+    // Taken before wrapping so interpolation never crosses the seam.
+    last_step_phi_ = rotation_phi_ - last_phi;
+    while (rotation_phi_ > 2 * glm::pi<float>()) {
+      rotation_phi_ -= 2 * glm::pi<float>();
+    }
+    while (rotation_phi_ < 0.0f) {
+      rotation_phi_ += 2 * glm::pi<float>();
+    }
+    if (rotation_theta_ > glm::pi<float>() - 1e-3f) {
+      rotation_theta_ = glm::pi<float>() - 1e-3f;
+    } else if (rotation_theta_ < 1e-3f) {
+      rotation_theta_ = 1e-3f;
+    }
+    last_step_theta_ = rotation_theta_ - last_theta;
   }
 
-  BezierGlobalUniformObject ubo{};
-  ubo.proj =
-      glm::perspective(glm::radians(45.0f),
-                       static_cast<float>(Swapchain()->Extent().width) /
-                           static_cast<float>(Swapchain()->Extent().height),
-                       0.1f, 10.0f);
+  float rewind = 1.0f - InterpolationAlpha();
+  float phi = rotation_phi_ - rewind * last_step_phi_;
+  float theta = rotation_theta_ - rewind * last_step_theta_;
+
+  BezierGlobalUniformObject &ubo = global_uniform_object_;
+  ubo.proj = glm::perspective(glm::radians(45.0f),
+                              static_cast<float>(FrameExtent().width) /
+                                  static_cast<float>(FrameExtent().height),
+                              0.1f, 10.0f);
   float camera_dist = 3.0f;
-  glm::vec3 camera_pos =
-      glm::vec3(glm::sin(rotation_phi_) * glm::sin(rotation_theta_),
-                glm::cos(rotation_theta_),
-                glm::cos(rotation_phi_) * glm::sin(rotation_theta_)) *
-      camera_dist;
+  glm::vec3 camera_pos = glm::vec3(glm::sin(phi) * glm::sin(theta),
+                                   glm::cos(theta),
+                                   glm::cos(phi) * glm::sin(theta)) *
+                         camera_dist;
   ubo.view = glm::lookAt(camera_pos, glm::vec3(0.0f, 0.0f, 0.0f),
                          glm::vec3(0.0f, 1.0f, 0.0f));
   for (int i = 0; i < 5; i++) {
@@ -81,13 +91,21 @@ void Bezier::OnUpdateImpl() {
     }
   }
   ubo.tess_level = tess_level_;
-  global_uniform_buffer_->At(0) = ubo;
+  if (std::memcmp(&last_global_uniform_object, &ubo, sizeof(ubo)) != 0) {
+    MarkDirty();
+  }
+}
+
+void Bezier::OnSnapshotImpl() {
+  global_uniform_buffer_->At(0) = global_uniform_object_;
+  render_wireframe_ = wireframe_;
 }
 
 void Bezier::OnRenderImpl(VkCommandBuffer cmd_buffer) {
   vkCmdBindPipeline(
       cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-      wireframe_ ? pipeline_->Handle() : texture_pipeline_->Handle());
+      pipelines_->Get(render_wireframe_ ? kWireframeVariant : kTexturedVariant)
+          ->Handle());
 
   VkDescriptorSet descriptor_set = descriptor_sets_[CurrentFrame()]->Handle();
 
@@ -102,9 +120,8 @@ void Bezier::CreateAssets() {
   global_uniform_buffer_ =
       std::make_shared<DynamicBuffer<BezierGlobalUniformObject>>(this, 1);
 
-  Image texture;
-  texture.ReadFromFile(ASSETS_PATH "texture/texture.jpg");
-  texture_image_ = std::make_shared<TextureImage>(this, texture);
+  texture_image_ =
+      LoadTexture(ASSETS_PATH "texture/texture.jpg", StartupUploads());
 }
 
 void Bezier::DestroyAssets() {
@@ -178,85 +195,69 @@ void Bezier::CreatePipeline() {
   IgnoreResult(Device()->CreatePipelineLayout(
       {descriptor_set_layout_->Handle()}, &pipeline_layout_));
 
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/bezier.vert"),
-                                 VK_SHADER_STAGE_VERTEX_BIT),
-      &vertex_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/bezier.tesc"),
-                                 VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT),
-      &tess_control_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/bezier.tese"),
-                                 VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT),
-      &tess_evaluation_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/bezier.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &fragment_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/bezier_texture.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &texture_fragment_shader_));
-
-  vulkan::PipelineSettings settings(RenderPass(), pipeline_layout_.get());
-  settings.AddShaderStage(vertex_shader_.get(), VK_SHADER_STAGE_VERTEX_BIT);
-  settings.AddShaderStage(tess_control_shader_.get(),
-                          VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
-  settings.AddShaderStage(tess_evaluation_shader_.get(),
-                          VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
-  settings.AddShaderStage(fragment_shader_.get(), VK_SHADER_STAGE_FRAGMENT_BIT);
-  settings.SetCullMode(VK_CULL_MODE_NONE);
-  settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_PATCH_LIST);
-  settings.SetPolygonMode(VK_POLYGON_MODE_LINE);
-  settings.SetTessellationState(4);
-
-  IgnoreResult(Device()->CreatePipeline(settings, &pipeline_));
-
-  vulkan::PipelineSettings texture_settings(RenderPass(),
-                                            pipeline_layout_.get());
-  texture_settings.AddShaderStage(vertex_shader_.get(),
-                                  VK_SHADER_STAGE_VERTEX_BIT);
-  texture_settings.AddShaderStage(tess_control_shader_.get(),
-                                  VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
-  texture_settings.AddShaderStage(tess_evaluation_shader_.get(),
-                                  VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
-  texture_settings.AddShaderStage(texture_fragment_shader_.get(),
-                                  VK_SHADER_STAGE_FRAGMENT_BIT);
-  texture_settings.SetCullMode(VK_CULL_MODE_NONE);
-  texture_settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_PATCH_LIST);
-  texture_settings.SetPolygonMode(VK_POLYGON_MODE_FILL);
-  texture_settings.SetTessellationState(4);
-  IgnoreResult(Device()->CreatePipeline(texture_settings, &texture_pipeline_));
+  StartupTask vertex = CreateShaderModuleAsync(
+      "shaders/bezier.vert", VK_SHADER_STAGE_VERTEX_BIT, &vertex_shader_);
+  StartupTask tess_control = CreateShaderModuleAsync(
+      "shaders/bezier.tesc", VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+      &tess_control_shader_);
+  StartupTask tess_evaluation = CreateShaderModuleAsync(
+      "shaders/bezier.tese", VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+      &tess_evaluation_shader_);
+  StartupTask fragment = CreateShaderModuleAsync(
+      "shaders/bezier.frag", VK_SHADER_STAGE_FRAGMENT_BIT, &fragment_shader_);
+
+  pipelines_ = std::make_unique<PipelineVariantCache>(
+      this, pipeline_layout_.get(),
+      [this](uint64_t key, vulkan::PipelineSettings *settings,
+             SpecializationConstants *constants) {
+        settings->AddShaderStage(vertex_shader_.get(),
+                                 VK_SHADER_STAGE_VERTEX_BIT);
+        settings->AddShaderStage(tess_control_shader_.get(),
+                                 VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
+        settings->AddShaderStage(tess_evaluation_shader_.get(),
+                                 VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
+        settings->AddShaderStage(fragment_shader_.get(),
+                                 VK_SHADER_STAGE_FRAGMENT_BIT);
+        settings->SetCullMode(VK_CULL_MODE_NONE);
+        settings->SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_PATCH_LIST);
+        settings->SetPolygonMode((key & kWireframeVariant)
+                                     ? VK_POLYGON_MODE_LINE
+                                     : VK_POLYGON_MODE_FILL);
+        settings->SetTessellationState(4);
+        constants->Set(kTexturedConstant, bool(key & kTexturedVariant));
+        constants->Set(kDegreeConstant, kBezierDegree);
+      });
+  // The two variants the demo switches between.
+  std::vector<StartupTask> modules = {vertex, tess_control, tess_evaluation,
+                                      fragment};
+  pipelines_->Prepare(kWireframeVariant, modules);
+  pipelines_->Prepare(kTexturedVariant, modules);
 }
 
 void Bezier::DestroyPipeline() {
-  texture_pipeline_.reset();
-  pipeline_.reset();
+  pipelines_.reset();
   vertex_shader_.reset();
   tess_control_shader_.reset();
   tess_evaluation_shader_.reset();
   fragment_shader_.reset();
-  texture_fragment_shader_.reset();
   pipeline_layout_.reset();
 }
 
 void Bezier::RandomizeControlPoints() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
   std::uniform_real_distribution<float> dis(-0.5f, 0.5f);
   for (int i = 0; i < 5; i++) {
     for (int j = 0; j < 5; j++) {
       y_grid_[i][j] =
-          dis(gen) * std::min(5 - i, i + 1) * std::min(5 - j, j + 1);
+          dis(random_) * std::min(5 - i, i + 1) * std::min(5 - j, j + 1);
     }
   }
 }
 
-void Bezier::OnKey(int key, int scancode, int action, int mods) {
+void Bezier::OnKeyImpl(int key, int scancode, int action, int mods) {
   if (action == GLFW_PRESS || action == GLFW_REPEAT) {
     if (key == GLFW_KEY_TAB) {
       wireframe_ = !wireframe_;
+      MarkDirty();
     }
     if (key == GLFW_KEY_SPACE) {
       RandomizeControlPoints();
@@ -1,6 +1,8 @@
 #pragma once
 #include "app.h"
 #include "buffer.h"
+#include "pipeline_variants.h"
+#include "random"
 #include "texture_image.h"
 
 struct BezierGlobalUniformObject {
@@ -12,7 +14,7 @@ struct BezierGlobalUniformObject {
 
 class Bezier : public Application {
  public:
-  Bezier();
+  explicit Bezier(const ApplicationSettings &settings = {});
 
  private:
   void OnInitImpl() override;
@@ -21,6 +23,8 @@ class Bezier : public Application {
 
   void OnUpdateImpl() override;
 
+  void OnSnapshotImpl() override;
+
   void OnRenderImpl(VkCommandBuffer cmd_buffer) override;
 
   void CreateAssets();
@@ -30,7 +34,7 @@ class Bezier : public Application {
   void DestroyDescriptorAssets();
   void DestroyPipeline();
 
-  void OnKey(int key, int scancode, int action, int mods);
+  void OnKeyImpl(int key, int scancode, int action, int mods) override;
 
   void RandomizeControlPoints();
 
@@ -40,7 +44,6 @@ class Bezier : public Application {
   std::shared_ptr<vulkan::ShaderModule> tess_control_shader_;
   std::shared_ptr<vulkan::ShaderModule> tess_evaluation_shader_;
   std::shared_ptr<vulkan::ShaderModule> fragment_shader_;
-  std::shared_ptr<vulkan::ShaderModule> texture_fragment_shader_;
 
   std::shared_ptr<DynamicBuffer<BezierGlobalUniformObject>>
       global_uniform_buffer_;
@@ -48,13 +51,17 @@ class Bezier : public Application {
   std::shared_ptr<vulkan::DescriptorPool> descriptor_pool_;
   std::vector<std::shared_ptr<vulkan::DescriptorSet>> descriptor_sets_;
   std::shared_ptr<vulkan::PipelineLayout> pipeline_layout_;
-  std::shared_ptr<vulkan::Pipeline> pipeline_;
-  std::shared_ptr<vulkan::Pipeline> texture_pipeline_;
+  std::unique_ptr<PipelineVariantCache> pipelines_;
 
   float rotation_phi_ = 0.0f;
   float rotation_theta_ = glm::radians(90.0f);
+  float last_step_phi_ = 0.0f;
+  float last_step_theta_ = 0.0f;
+  BezierGlobalUniformObject global_uniform_object_{};
 
   float y_grid_[5][5]{};
   int tess_level_{20};
   bool wireframe_{false};
+  bool render_wireframe_{false};
+  std::mt19937 random_;
 };
@@ -1,5 +1,9 @@
 #pragma once
+#include "algorithm"
 #include "app.h"
+#include "cstring"
+#include "stdexcept"
+#include "upload_batch.h"
 
 class Buffer {
  public:
@@ -23,30 +27,26 @@ class StaticBuffer : public Buffer {
             VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         VMA_MEMORY_USAGE_GPU_ONLY, &buffer_));
   }
-  ~StaticBuffer() = default;
+  ~StaticBuffer() {
+    app_->Retire(std::move(buffer_));
+  }
 
   [[nodiscard]] vulkan::Buffer *GetBuffer() const override {
     return buffer_.get();
   }
 
-  void Upload(const std::vector<Ty> &data) {
-    std::unique_ptr<vulkan::Buffer> staging_buffer;
-    IgnoreResult(app_->Device()->CreateBuffer(
-        sizeof(Ty) * data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_CPU_ONLY, &staging_buffer));
-
-    void *staging_data = staging_buffer->Map();
-    memcpy(staging_data, data.data(), sizeof(Ty) * data.size());
-    staging_buffer->Unmap();
-
-    vulkan::SingleTimeCommand(
-        app_->TransferQueue(), app_->TransferCommandPool(),
-        [&](VkCommandBuffer cmd_buffer) {
-          VkBufferCopy copy_region = {};
-          copy_region.size = sizeof(Ty) * data.size();
-          vkCmdCopyBuffer(cmd_buffer, staging_buffer->Handle(),
-                          buffer_->Handle(), 1, &copy_region);
-        });
+  // Records the copy into batch, which the caller submits, or uploads right
+  // away when it is null.
+  void Upload(const std::vector<Ty> &data, UploadBatch *batch = nullptr) {
+    if (batch) {
+      batch->UploadBuffer(buffer_.get(), data.data(), sizeof(Ty) * data.size());
+      return;
+    }
+    UploadBatch own_batch(app_->Context(), 0);
+    own_batch.UploadBuffer(buffer_.get(), data.data(),
+                           sizeof(Ty) * data.size());
+    own_batch.Submit();
+    own_batch.Wait();
   }
 
   size_t Size() const {
@@ -66,35 +66,81 @@ class DynamicBufferBase : public Buffer {
   virtual ~DynamicBufferBase() {
     app_->UnregisterDynamicBuffer(this);
   }
-  virtual void Sync(VkCommandBuffer cmd_buffer) = 0;
+  // Brings the current frame's buffer up to date, returns whether it
+  // recorded any commands into cmd_buffer.
+  virtual bool Sync(VkCommandBuffer cmd_buffer) = 0;
+};
+
+enum class DynamicBufferPolicy {
+  // Direct for buffers up to kMaxDirectDynamicBufferBytes when
+  // Application::DirectDynamicBuffers() allows it, staged otherwise.
+  kAuto,
+  // Copied by the transfer queue from a staging ring into GPU_ONLY
+  // buffers.
+  kStaged,
+  // CPU_TO_GPU buffers per frame in flight written and flushed by the CPU,
+  // without any transfer commands.
+  kDirect,
 };
 
+constexpr size_t kMaxDirectDynamicBufferBytes = 1 << 20;
+
+// Writes land in a host copy, and Sync moves the frame's dirty ranges to
+// the frame's buffer once the frame's in-flight fence has signaled. Staged
+// buffers go through that frame's slice of a persistently mapped staging
+// ring, direct ones are written through their own persistent mapping.
 template <class Ty>
 class DynamicBuffer : public DynamicBufferBase {
  public:
-  DynamicBuffer(Application *app, size_t size)
-      : DynamicBufferBase(app), size_(size) {
+  DynamicBuffer(Application *app,
+                size_t size,
+                DynamicBufferPolicy policy = DynamicBufferPolicy::kAuto)
+      : DynamicBufferBase(app), size_(size), data_(size) {
     uint32_t max_frames_in_flight = app->MaxFramesInFlight();
-    IgnoreResult(app_->Device()->CreateBuffer(
-        sizeof(Ty) * size_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_CPU_ONLY, &staging_buffer_));
+    direct_ = policy == DynamicBufferPolicy::kDirect ||
+              (policy == DynamicBufferPolicy::kAuto &&
+               sizeof(Ty) * size_ <= kMaxDirectDynamicBufferBytes &&
+               app->DirectDynamicBuffers());
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
     buffers_.resize(max_frames_in_flight);
-    buffer_versions_.resize(max_frames_in_flight, 0);
-    staging_version_ = 0;
+    dirty_ranges_.resize(max_frames_in_flight);
+    if (direct_) {
+      buffer_data_.resize(max_frames_in_flight);
+      for (uint32_t i = 0; i < max_frames_in_flight; i++) {
+        IgnoreResult(app_->Device()->CreateBuffer(
+            sizeof(Ty) * size_, usage, VMA_MEMORY_USAGE_CPU_TO_GPU,
+            &buffers_[i]));
+        buffer_data_[i] = reinterpret_cast<uint8_t *>(buffers_[i]->Map());
+      }
+      return;
+    }
 
+    IgnoreResult(app_->Device()->CreateBuffer(
+        sizeof(Ty) * size_ * max_frames_in_flight,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
+        &staging_buffer_));
+    staging_data_ = reinterpret_cast<uint8_t *>(staging_buffer_->Map());
     for (uint32_t i = 0; i < max_frames_in_flight; i++) {
       IgnoreResult(app_->Device()->CreateBuffer(
-          sizeof(Ty) * size_,
-          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
-              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-              VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+          sizeof(Ty) * size_, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
           VMA_MEMORY_USAGE_GPU_ONLY, &buffers_[i]));
     }
   }
 
   ~DynamicBuffer() override {
+    if (staging_buffer_) {
+      staging_buffer_->Unmap();
+      app_->Retire(std::move(staging_buffer_));
+    }
+    for (auto &buffer : buffers_) {
+      if (direct_) {
+        buffer->Unmap();
+      }
+      app_->Retire(std::move(buffer));
+    }
   }
 
   [[nodiscard]] vulkan::Buffer *GetBuffer(uint32_t index) const {
@@ -105,60 +151,113 @@ class DynamicBuffer : public DynamicBufferBase {
     return GetBuffer(app_->CurrentFrame());
   }
 
-  void Sync(VkCommandBuffer cmd_buffer) override {
-    Unmap();
+  // Moves the element ranges written since this frame's buffer was last
+  // synced, one copy per merged range. Called after the frame's in-flight
+  // fence is waited, so neither its buffer nor its staging slice is read.
+  bool Sync(VkCommandBuffer cmd_buffer) override {
     uint32_t current_frame = app_->CurrentFrame();
-    if (staging_version_ != buffer_versions_[current_frame]) {
-      vulkan::CopyBuffer(cmd_buffer, staging_buffer_.get(),
-                         buffers_[current_frame].get(),
-                         staging_buffer_->Size());
-      buffer_versions_[current_frame] = staging_version_;
+    auto &ranges = dirty_ranges_[current_frame];
+    if (ranges.empty()) {
+      return false;
     }
-  }
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<VkBufferCopy> regions;
+    for (auto &range : ranges) {
+      VkDeviceSize begin = sizeof(Ty) * range.first;
+      VkDeviceSize end = sizeof(Ty) * range.second;
+      if (!regions.empty() &&
+          regions.back().dstOffset + regions.back().size >= begin) {
+        VkBufferCopy &last = regions.back();
+        last.size = std::max(last.size, end - last.dstOffset);
+        continue;
+      }
+      regions.push_back({begin, begin, end - begin});
+    }
+    ranges.clear();
 
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(data_.data());
+    if (direct_) {
+      // CPU_TO_GPU memory is not necessarily coherent. Flushing coherent
+      // memory is a no-op, and VMA rounds the range to nonCoherentAtomSize.
+      for (auto &region : regions) {
+        std::memcpy(buffer_data_[current_frame] + region.dstOffset,
+                    data + region.dstOffset, region.size);
+        if (vmaFlushAllocation(app_->Device()->Allocator(),
+                               buffers_[current_frame]->Allocation(),
+                               region.dstOffset,
+                               region.size) != VK_SUCCESS) {
+          throw std::runtime_error("Failed to flush dynamic buffer.");
+        }
+      }
+      return false;
+    }
+    VkDeviceSize slice_offset = sizeof(Ty) * size_ * current_frame;
+    for (auto &region : regions) {
+      region.srcOffset += slice_offset;
+      std::memcpy(staging_data_ + region.srcOffset, data + region.dstOffset,
+                  region.size);
+    }
+    vkCmdCopyBuffer(cmd_buffer, staging_buffer_->Handle(),
+                    buffers_[current_frame]->Handle(),
+                    uint32_t(regions.size()), regions.data());
+    return true;
+  }
   Ty &At(uint32_t index) {
-    Map();
-    return staging_data_[index];
+    MarkDirty(index, 1);
+    return data_[index];
   }
 
   const Ty &At(uint32_t index) const {
-    Map();
-    return staging_data_[index];
+    return data_[index];
   }
 
+  // Marks the whole buffer as written, prefer Data(begin, count) when only
+  // part of it changes.
   Ty *Data() {
-    Map();
-    return staging_data_;
+    MarkDirty(0, size_);
+    return data_.data();
   }
 
-  const Ty *Data() const {
-    Map();
-    return staging_data_;
+  Ty *Data(size_t begin, size_t count) {
+    MarkDirty(begin, count);
+    return data_.data() + begin;
   }
 
-  [[nodiscard]] size_t Size() const {
-    return size_;
+  const Ty *Data() const {
+    return data_.data();
   }
 
- private:
-  void Map() {
-    if (staging_data_ == nullptr) {
-      staging_data_ = reinterpret_cast<Ty *>(staging_buffer_->Map());
-      staging_version_++;
+  // Queues [begin, begin + count) for every frame's copy.
+  void MarkDirty(size_t begin, size_t count) {
+    if (!count) {
+      return;
+    }
+    size_t end = std::min(begin + count, size_);
+    for (auto &ranges : dirty_ranges_) {
+      if (begin == 0 && end == size_) {
+        ranges.assign(1, {begin, end});
+      } else if (!ranges.empty() && ranges.back().second == begin) {
+        ranges.back().second = end;
+      } else if (ranges.empty() || ranges.back().first != begin ||
+                 ranges.back().second != end) {
+        ranges.emplace_back(begin, end);
+      }
     }
   }
 
-  void Unmap() {
-    if (staging_data_) {
-      staging_data_ = nullptr;
-      staging_buffer_->Unmap();
-    }
+  [[nodiscard]] size_t Size() const {
+    return size_;
   }
 
+ private:
   size_t size_;
+  std::vector<Ty> data_;
+  bool direct_{false};
   std::unique_ptr<vulkan::Buffer> staging_buffer_;
+  uint8_t *staging_data_{nullptr};
   std::vector<std::unique_ptr<vulkan::Buffer>> buffers_;
-  uint64_t staging_version_{};
-  std::vector<uint64_t> buffer_versions_{};
-  Ty *staging_data_{nullptr};
+  // Persistent mappings of buffers_, direct buffers only.
+  std::vector<uint8_t *> buffer_data_;
+  // Element ranges [first, second) each frame's buffer is missing.
+  std::vector<std::vector<std::pair<size_t, size_t>>> dirty_ranges_;
 };
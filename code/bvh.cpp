@@ -0,0 +1,298 @@
+#include "bvh.h"
+
+#include "algorithm"
+#include "limits"
+#include "stdexcept"
+
+namespace {
+constexpr uint32_t kMaxLeafSize = 4;
+constexpr uint32_t kMaxFallbackLeafSize = 64;
+constexpr int kSahBins = 16;
+// Relative cost of a box test against a triangle test.
+constexpr float kTraversalCost = 1.0f;
+constexpr float kIntersectionCost = 1.0f;
+constexpr size_t kMaxStackDepth = 128;
+constexpr float kMinHitDistance = 1e-5f;
+
+float SurfaceArea(const glm::vec3 &min, const glm::vec3 &max) {
+  glm::vec3 extent = glm::max(max - min, glm::vec3{0.0f});
+  return 2.0f * (extent.x * extent.y + extent.y * extent.z +
+                 extent.z * extent.x);
+}
+}  // namespace
+
+Bvh::Bvh(const std::vector<glm::vec3> &positions,
+         const std::vector<uint32_t> &indices) {
+  uint32_t count = indices.size() / 3;
+  std::vector<Triangle> input(count);
+  bounds_min_.resize(count);
+  bounds_max_.resize(count);
+  centroids_.resize(count);
+  triangle_ids_.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec3 v0 = positions[indices[i * 3]];
+    glm::vec3 v1 = positions[indices[i * 3 + 1]];
+    glm::vec3 v2 = positions[indices[i * 3 + 2]];
+    input[i] = {v0, v1 - v0, v2 - v0};
+    bounds_min_[i] = glm::min(v0, glm::min(v1, v2));
+    bounds_max_[i] = glm::max(v0, glm::max(v1, v2));
+    centroids_[i] = (bounds_min_[i] + bounds_max_[i]) * 0.5f;
+    triangle_ids_[i] = i;
+  }
+
+  if (count) {
+    nodes_.reserve(count * 2);
+    Build(0, count);
+  }
+
+  triangles_.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    triangles_[i] = input[triangle_ids_[i]];
+  }
+  bounds_min_ = {};
+  bounds_max_ = {};
+  centroids_ = {};
+}
+
+uint32_t Bvh::Build(uint32_t begin, uint32_t end) {
+  uint32_t index = nodes_.size();
+  nodes_.push_back({});
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+  glm::vec3 centroid_min = min;
+  glm::vec3 centroid_max = max;
+  for (uint32_t i = begin; i < end; i++) {
+    uint32_t id = triangle_ids_[i];
+    min = glm::min(min, bounds_min_[id]);
+    max = glm::max(max, bounds_max_[id]);
+    centroid_min = glm::min(centroid_min, centroids_[id]);
+    centroid_max = glm::max(centroid_max, centroids_[id]);
+  }
+  nodes_[index].min = min;
+  nodes_[index].max = max;
+
+  uint32_t count = end - begin;
+  auto make_leaf = [&]() {
+    nodes_[index].offset = begin;
+    nodes_[index].count = uint16_t(count);
+    return index;
+  };
+  if (count <= kMaxLeafSize) {
+    return make_leaf();
+  }
+
+  // Binned SAH over the centroid bounds of every axis.
+  int best_axis = -1;
+  int best_split = 0;
+  float best_cost = kIntersectionCost * float(count);
+  glm::vec3 centroid_extent = centroid_max - centroid_min;
+  for (int axis = 0; axis < 3; axis++) {
+    if (centroid_extent[axis] <= 0.0f) {
+      continue;
+    }
+    struct Bin {
+      glm::vec3 min{std::numeric_limits<float>::max()};
+      glm::vec3 max{std::numeric_limits<float>::lowest()};
+      uint32_t count{0};
+    } bins[kSahBins];
+    float scale = float(kSahBins) / centroid_extent[axis];
+    for (uint32_t i = begin; i < end; i++) {
+      uint32_t id = triangle_ids_[i];
+      int bin = std::min(
+          kSahBins - 1,
+          int((centroids_[id][axis] - centroid_min[axis]) * scale));
+      bins[bin].min = glm::min(bins[bin].min, bounds_min_[id]);
+      bins[bin].max = glm::max(bins[bin].max, bounds_max_[id]);
+      bins[bin].count++;
+    }
+
+    // Sweep from the right to get the cost of every split's right side.
+    float right_area[kSahBins];
+    uint32_t right_count[kSahBins];
+    Bin right;
+    for (int bin = kSahBins - 1; bin > 0; bin--) {
+      right.min = glm::min(right.min, bins[bin].min);
+      right.max = glm::max(right.max, bins[bin].max);
+      right.count += bins[bin].count;
+      right_area[bin] = SurfaceArea(right.min, right.max);
+      right_count[bin] = right.count;
+    }
+    Bin left;
+    for (int split = 1; split < kSahBins; split++) {
+      left.min = glm::min(left.min, bins[split - 1].min);
+      left.max = glm::max(left.max, bins[split - 1].max);
+      left.count += bins[split - 1].count;
+      if (!left.count || !right_count[split]) {
+        continue;
+      }
+      float cost =
+          kTraversalCost +
+          kIntersectionCost *
+              (SurfaceArea(left.min, left.max) * float(left.count) +
+               right_area[split] * float(right_count[split])) /
+              SurfaceArea(min, max);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split;
+      }
+    }
+  }
+
+  uint32_t middle;
+  if (best_axis >= 0) {
+    float scale = float(kSahBins) / centroid_extent[best_axis];
+    middle = std::partition(triangle_ids_.begin() + begin,
+                            triangle_ids_.begin() + end,
+                            [&](uint32_t id) {
+                              int bin = std::min(
+                                  kSahBins - 1,
+                                  int((centroids_[id][best_axis] -
+                                       centroid_min[best_axis]) *
+                                      scale));
+                              return bin < best_split;
+                            }) -
+             triangle_ids_.begin();
+  } else if (count <= kMaxFallbackLeafSize) {
+    return make_leaf();
+  } else {
+    // Splitting never pays off, but the leaf would be too large: halve it
+    // along the widest axis.
+    best_axis = 0;
+    for (int axis = 1; axis < 3; axis++) {
+      if (max[axis] - min[axis] > max[best_axis] - min[best_axis]) {
+        best_axis = axis;
+      }
+    }
+    middle = begin + count / 2;
+    std::nth_element(triangle_ids_.begin() + begin,
+                     triangle_ids_.begin() + middle,
+                     triangle_ids_.begin() + end,
+                     [&](uint32_t a, uint32_t b) {
+                       return centroids_[a][best_axis] <
+                              centroids_[b][best_axis];
+                     });
+  }
+
+  nodes_[index].axis = uint16_t(best_axis);
+  Build(begin, middle);
+  uint32_t second = Build(middle, end);
+  nodes_[index].offset = second;
+  return index;
+}
+
+void Bvh::Intersect(const RayPacket &packet, RayHit hits[4]) const {
+  for (int lane = 0; lane < 4; lane++) {
+    hits[lane] = {};
+  }
+  if (nodes_.empty()) {
+    return;
+  }
+
+  Float4 origin[3], direction[3], inv_direction[3];
+  for (int axis = 0; axis < 3; axis++) {
+    origin[axis] = Float4::Load(packet.origin[axis]);
+    direction[axis] = Float4::Load(packet.direction[axis]);
+    inv_direction[axis] = Float4::Splat(1.0f) / direction[axis];
+  }
+  const Float4 zero = Float4::Splat(0.0f);
+  const Float4 one = Float4::Splat(1.0f);
+  Float4 t_best = Float4::Load(packet.t_max);
+  const Float4 active = t_best > zero;
+  Float4 u_best = zero;
+  Float4 v_best = zero;
+  int32_t ids[4] = {-1, -1, -1, -1};
+  int first_lane = 0;
+  while (first_lane < 3 && packet.t_max[first_lane] <= 0.0f) {
+    first_lane++;
+  }
+
+  uint32_t stack[kMaxStackDepth];
+  size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size) {
+    const Node &node = nodes_[stack[--stack_size]];
+    // Slab test. The NaNs of rays parallel to a slab starting on the ray
+    // origin fall to the second operand of Min and Max, the running bound.
+    Float4 t_enter = zero;
+    Float4 t_exit = t_best;
+    for (int axis = 0; axis < 3; axis++) {
+      Float4 t0 = (Float4::Splat(node.min[axis]) - origin[axis]) *
+                  inv_direction[axis];
+      Float4 t1 = (Float4::Splat(node.max[axis]) - origin[axis]) *
+                  inv_direction[axis];
+      t_enter = Max(Min(t0, t1), t_enter);
+      t_exit = Min(Max(t0, t1), t_exit);
+    }
+    if (!(active & (t_enter <= t_exit)).MoveMask()) {
+      continue;
+    }
+
+    if (!node.count) {
+      // Visit the child nearer to the first active ray first.
+      uint32_t near_child = uint32_t(&node - nodes_.data()) + 1;
+      uint32_t far_child = node.offset;
+      if (packet.direction[node.axis][first_lane] < 0.0f) {
+        std::swap(near_child, far_child);
+      }
+      if (stack_size + 2 > kMaxStackDepth) {
+        throw std::runtime_error("BVH is too deep to traverse.");
+      }
+      stack[stack_size++] = far_child;
+      stack[stack_size++] = near_child;
+      continue;
+    }
+
+    for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+      const Triangle &triangle = triangles_[i];
+      Float4 v0[3], edge1[3], edge2[3];
+      for (int axis = 0; axis < 3; axis++) {
+        v0[axis] = Float4::Splat(triangle.v0[axis]);
+        edge1[axis] = Float4::Splat(triangle.edge1[axis]);
+        edge2[axis] = Float4::Splat(triangle.edge2[axis]);
+      }
+      // Moller-Trumbore, with degenerate and parallel cases failing the
+      // comparisons through infinities and NaNs.
+      Float4 p[3] = {direction[1] * edge2[2] - direction[2] * edge2[1],
+                     direction[2] * edge2[0] - direction[0] * edge2[2],
+                     direction[0] * edge2[1] - direction[1] * edge2[0]};
+      Float4 det = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+      Float4 inv_det = one / det;
+      Float4 s[3] = {origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]};
+      Float4 u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+      Float4 q[3] = {s[1] * edge1[2] - s[2] * edge1[1],
+                     s[2] * edge1[0] - s[0] * edge1[2],
+                     s[0] * edge1[1] - s[1] * edge1[0]};
+      Float4 v = (direction[0] * q[0] + direction[1] * q[1] +
+                  direction[2] * q[2]) *
+                 inv_det;
+      Float4 t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) *
+                 inv_det;
+      Float4 hit = active & (u >= zero) & (v >= zero) & (u + v <= one) &
+                   (t > Float4::Splat(kMinHitDistance)) & (t < t_best);
+      int mask = hit.MoveMask();
+      if (!mask) {
+        continue;
+      }
+      t_best = Select(hit, t, t_best);
+      u_best = Select(hit, u, u_best);
+      v_best = Select(hit, v, v_best);
+      for (int lane = 0; lane < 4; lane++) {
+        if (mask & (1 << lane)) {
+          ids[lane] = int32_t(triangle_ids_[i]);
+        }
+      }
+    }
+  }
+
+  float t_values[4], u_values[4], v_values[4];
+  t_best.Store(t_values);
+  u_best.Store(u_values);
+  v_best.Store(v_values);
+  for (int lane = 0; lane < 4; lane++) {
+    if (ids[lane] >= 0) {
+      hits[lane] = {ids[lane], t_values[lane], u_values[lane],
+                    v_values[lane]};
+    }
+  }
+}
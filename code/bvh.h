@@ -0,0 +1,64 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "simd.h"
+#include "vector"
+
+// Four rays traced together. Lanes whose t_max is not positive are inactive.
+struct RayPacket {
+  float origin[3][4];
+  float direction[3][4];
+  float t_max[4];
+};
+
+struct RayHit {
+  // Triangle index in the order passed to the constructor, -1 on a miss.
+  int32_t triangle{-1};
+  float t{};
+  // Barycentric weights of the second and third vertices.
+  float u{};
+  float v{};
+};
+
+// Bounding volume hierarchy over a triangle list, split with the surface
+// area heuristic and traversed with four ray packets.
+class Bvh {
+ public:
+  Bvh(const std::vector<glm::vec3> &positions,
+      const std::vector<uint32_t> &indices);
+
+  // Closest hit of every active ray, triangles are hit from both sides.
+  void Intersect(const RayPacket &packet, RayHit hits[4]) const;
+
+  [[nodiscard]] size_t NodeCount() const {
+    return nodes_.size();
+  }
+
+ private:
+  struct Node {
+    glm::vec3 min;
+    // First triangle of a leaf, second child of an interior node. The first
+    // child directly follows its parent.
+    uint32_t offset;
+    glm::vec3 max;
+    // Triangles in a leaf, 0 for interior nodes.
+    uint16_t count;
+    uint16_t axis;
+  };
+
+  struct Triangle {
+    glm::vec3 v0;
+    glm::vec3 edge1;
+    glm::vec3 edge2;
+  };
+
+  uint32_t Build(uint32_t begin, uint32_t end);
+
+  std::vector<Node> nodes_;
+  std::vector<Triangle> triangles_;
+  // Input index of every triangle in triangles_.
+  std::vector<uint32_t> triangle_ids_;
+  // Build-time bounds and centroids, indexed by input triangle.
+  std::vector<glm::vec3> bounds_min_;
+  std::vector<glm::vec3> bounds_max_;
+  std::vector<glm::vec3> centroids_;
+};
@@ -0,0 +1,59 @@
+#include "celestial_bodies.h"
+
+#include "cmath"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+constexpr float kCameraDistance = 15.0f;
+}  // namespace
+
+glm::mat4 SolarSystemProjection(float aspect) {
+  return glm::perspective(glm::radians(45.0f), aspect, 0.1f, 40.0f);
+}
+
+glm::mat4 SolarSystemView(float camera_theta) {
+  return glm::lookAt(
+      glm::vec3{std::sin(camera_theta) * kCameraDistance, 0.0f,
+                std::cos(camera_theta) * kCameraDistance},
+      glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+}
+
+const std::vector<CelestialBodyInfo> &SolarSystemBodies() {
+  // clang-format off
+  static const std::vector<CelestialBodyInfo> bodies = {
+      {"Sun", -1, 1.2f, 0.0f, 365.0f / 25.0f, 0.0f, 0.0f, 0.0f, ASSETS_PATH "texture/sun.jpg"},
+      {"Mercury", -1, 0.05f, 1.35f, 1.0f / 58.6462f, 365.2564f / 87.9674f, 0.0f, 100.0f, ASSETS_PATH "texture/mercury.jpg"},
+      {"Venus", -1, 0.16f, 1.6f, 1.0f / 243.0187f, 365.2564f / 224.6960f, 0.0f, 200.0f, ASSETS_PATH "texture/venus.jpg"},
+      {"Earth", -1, 0.18f, 2.0f, 1.0f, 365.2564f / 365.2564f, 0.0f, 300.0f, ASSETS_PATH "texture/earth.jpg"},
+      {"Mars", -1, 0.1f, 2.4f, 23.9345f / 24.6230, 365.2564f / 686.9649, 0.0f, 400.0f, ASSETS_PATH "texture/mars.jpg"},
+      {"Jupiter", -1, 0.8f, 3.4f, 23.9345f / 9.9250f, 3.0f / 11.862615, 0.0f, 800.0f, ASSETS_PATH "texture/jupiter.jpg"},
+      {"Saturn", -1, 0.7f, 5.2f, 23.9345f / 10.6562f, 3.0f / 29.447498, 0.0f, 1600.0f, ASSETS_PATH "texture/saturn.jpg"},
+      {"Uranus", -1, 0.6f, 6.7f, 23.9345f / 17.2399f, 3.0f / 84.016846, 0.0f, 2200.0f, ASSETS_PATH "texture/uranus.jpg"},
+      {"Neptune", -1, 0.55f, 8.2f, 23.9345f / 16.1100f, 3.0f / 164.79132, 0.0f, 3000.0f, ASSETS_PATH "texture/neptune.jpg"},
+      {"Moon", 3, 0.03f, 0.2f, -12.0f, 12.0f, 0.0f, 0.0f, ASSETS_PATH "texture/moon.jpg"},
+  };
+  // clang-format on
+  return bodies;
+}
+
+void ComputeCelestialTransforms(const CelestialBodyInfo &info,
+                                const glm::mat4 &parent_world,
+                                float t,
+                                glm::mat4 *world,
+                                glm::mat4 *local) {
+  float revolution_angle = info.revolution_speed * t + info.revolution_phase;
+  float rotation_angle = info.rotation_speed * t + info.rotation_phase;
+
+  glm::mat4 revolution_transform =
+      glm::rotate(glm::mat4{1.0f}, revolution_angle,
+                  glm::vec3{0.0f, 1.0f, 0.0f}) *
+      glm::translate(glm::mat4{1.0f},
+                     glm::vec3{info.revolution_radius, 0.0f, 0.0f});
+  glm::mat4 rotation_transform =
+      glm::rotate(glm::mat4{1.0f}, rotation_angle,
+                  glm::vec3{0.0f, 1.0f, 0.0f}) *
+      glm::scale(glm::mat4{1.0f}, glm::vec3{info.radius});
+
+  *world = parent_world * revolution_transform;
+  *local = rotation_transform;
+}
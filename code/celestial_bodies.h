@@ -0,0 +1,33 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "string"
+#include "vector"
+
+struct CelestialBodyInfo {
+  std::string name;
+  // Index of the body this one orbits, -1 for the origin.
+  int parent;
+  float radius;
+  float revolution_radius;
+  float rotation_speed;
+  float revolution_speed;
+  float rotation_phase;
+  float revolution_phase;
+  std::string texture_path;
+};
+
+// Camera of the solar system scene, circling the origin camera_theta
+// radians around the y axis from +z.
+glm::mat4 SolarSystemProjection(float aspect);
+glm::mat4 SolarSystemView(float camera_theta);
+
+// The bodies of the solar system scene, parents before their satellites.
+const std::vector<CelestialBodyInfo> &SolarSystemBodies();
+
+// Places the body at time t. world is the orbit position the satellites
+// follow, local the spin and scale applied to the body alone.
+void ComputeCelestialTransforms(const CelestialBodyInfo &info,
+                                const glm::mat4 &parent_world,
+                                float t,
+                                glm::mat4 *world,
+                                glm::mat4 *local);
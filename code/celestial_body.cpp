@@ -4,26 +4,10 @@
 
 CelestialBody::CelestialBody(SolarSystem *solar_system,
                              CelestialBody *parent,
-                             float radius,
-                             float revolution_radius,
-                             float rotation_speed,
-                             float revolution_speed,
-                             float rotation_phase,
-                             float revolution_phase,
-                             const std::string &texture_path,
-                             std::string name)
-    : solar_system_(solar_system),
-      parent_(parent),
-      radius_(radius),
-      rotation_speed_(rotation_speed),
-      rotation_phase_(rotation_phase),
-      revolution_speed_(revolution_speed),
-      revolution_phase_(revolution_phase),
-      revolution_radius_(revolution_radius),
-      name_(std::move(name)) {
-  Image image;
-  image.ReadFromFile(texture_path);
-  texture_ = std::make_unique<TextureImage>(solar_system_, image);
+                             const CelestialBodyInfo &info)
+    : solar_system_(solar_system), parent_(parent), info_(info) {
+  texture_ = solar_system_->LoadTexture(info_.texture_path,
+                                        solar_system_->StartupUploads());
   entity_ = std::make_unique<Entity>(
       solar_system_, solar_system_->GetSphereModel(), texture_.get());
 }
@@ -37,22 +21,11 @@ void CelestialBody::Update(float t) {
   if (parent_) {
     ref_transform = parent_->WorldTransform();
   }
-  float revolution_angle = revolution_speed_ * t + revolution_phase_;
-  float rotation_angle = rotation_speed_ * t + rotation_phase_;
-
-  glm::mat4 revolution_transform =
-      glm::rotate(glm::mat4{1.0f}, revolution_angle,
-                  glm::vec3{0.0f, 1.0f, 0.0f}) *
-      glm::translate(glm::mat4{1.0f},
-                     glm::vec3{revolution_radius_, 0.0f, 0.0f});
-  glm::mat4 rotation_transform =
-      glm::rotate(glm::mat4{1.0f}, rotation_angle,
-                  glm::vec3{0.0f, 1.0f, 0.0f}) *
-      glm::scale(glm::mat4{1.0f}, glm::vec3{radius_});
-
-  world_transform_ = ref_transform * revolution_transform;
-  local_transform_ = rotation_transform;
+  ComputeCelestialTransforms(info_, ref_transform, t, &world_transform_,
+                             &local_transform_);
+}
 
+void CelestialBody::Sync() const {
   EntityUniformObject entity_info{};
   entity_info.model_ = world_transform_ * local_transform_;
   entity_->SetEntityInfo(entity_info);
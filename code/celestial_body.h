@@ -1,6 +1,7 @@
 #pragma once
 #include "app.h"
 #include "buffer.h"
+#include "celestial_bodies.h"
 #include "entity.h"
 #include "texture_image.h"
 
@@ -10,16 +11,11 @@ class CelestialBody {
  public:
   CelestialBody(SolarSystem *solar_system,
                 CelestialBody *parent,
-                float radius,
-                float revolution_radius,
-                float rotation_speed,
-                float revolution_speed,
-                float rotation_phase,
-                float revolution_phase,
-                const std::string &texture_path,
-                std::string name);
+                const CelestialBodyInfo &info);
 
   void Update(float t);
+  // Writes the transform computed by Update to the entity's uniform buffer.
+  void Sync() const;
 
   void Render(VkCommandBuffer cmd_buffer) const;
 
@@ -36,28 +32,21 @@ class CelestialBody {
   }
 
   [[nodiscard]] std::string GetName() const {
-    return name_;
+    return info_.name;
   }
 
   [[nodiscard]] float GetRadius() const {
-    return radius_;
+    return info_.radius;
   }
 
  private:
   SolarSystem *solar_system_;
   CelestialBody *parent_;
-  float radius_;
-  float rotation_speed_;
-  float rotation_phase_;
-  float revolution_speed_;
-  float revolution_phase_;
-  float revolution_radius_;
-
-  std::unique_ptr<TextureImage> texture_;
+  CelestialBodyInfo info_;
+
+  std::shared_ptr<TextureImage> texture_;
   std::unique_ptr<Entity> entity_;
 
   glm::mat4 world_transform_;
   glm::mat4 local_transform_;
-
-  std::string name_;
 };
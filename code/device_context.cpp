@@ -0,0 +1,145 @@
+#include "device_context.h"
+
+#include "cstring"
+#include "image.h"
+#include "stdexcept"
+#include "texture_image.h"
+
+namespace {
+constexpr const char *kPipelineCacheFile = "pipeline_cache.bin";
+}  // namespace
+
+DeviceContext::DeviceContext(std::string cache_dir)
+    : cache_dir_(std::move(cache_dir)) {
+  vulkan::InstanceCreateHint instance_create_hint;
+  if (vulkan::CreateInstance(instance_create_hint, &instance_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create vulkan instance.");
+  }
+}
+
+DeviceContext::~DeviceContext() {
+  if (device_) {
+    IgnoreResult(device_->WaitIdle());
+  }
+  textures_.clear();
+  entity_sampler_.reset();
+  DestroyPipelineCache();
+  transfer_command_pool_.reset();
+  transfer_queue_.reset();
+  graphics_queue_.reset();
+  device_.reset();
+  instance_.reset();
+}
+
+void DeviceContext::CreateDevice(vulkan::Surface *surface) {
+  if (device_) {
+    return;
+  }
+  vulkan::DeviceFeatureRequirement feature_requirement;
+  feature_requirement.surface = surface;
+  if (instance_->CreateDevice(feature_requirement, &device_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create vulkan logical device.");
+  }
+  if (device_->GetQueue(device_->PhysicalDevice().GraphicsFamilyIndex(), 0,
+                        &graphics_queue_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to get graphics queue.");
+  }
+  if (device_->GetQueue(device_->PhysicalDevice().TransferFamilyIndex(), -1,
+                        &transfer_queue_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to get transfer queue.");
+  }
+  if (device_->CreateCommandPool(
+          device_->PhysicalDevice().TransferFamilyIndex(),
+          VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          &transfer_command_pool_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create transfer command pool.");
+  }
+  if (device_->CreateSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+                             VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                             VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                             VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, false,
+                             VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+                             VK_SAMPLER_MIPMAP_MODE_LINEAR,
+                             &entity_sampler_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create entity sampler.");
+  }
+
+  VkPhysicalDeviceMemoryProperties memory_properties;
+  vkGetPhysicalDeviceMemoryProperties(device_->PhysicalDevice().Handle(),
+                                      &memory_properties);
+  VkMemoryPropertyFlags direct_flags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+    if ((memory_properties.memoryTypes[i].propertyFlags & direct_flags) ==
+        direct_flags) {
+      host_visible_device_local_ = true;
+    }
+  }
+  CreatePipelineCache();
+}
+
+std::shared_ptr<TextureImage> DeviceContext::LoadTexture(
+    const std::string &path,
+    UploadBatch *batch) {
+  std::lock_guard<std::mutex> lock(texture_mutex_);
+  auto &texture = textures_[path];
+  if (!texture) {
+    Image image;
+    image.ReadFromFile(path);
+    texture = std::make_shared<TextureImage>(this, image, batch);
+  }
+  return texture;
+}
+
+void DeviceContext::CreatePipelineCache() {
+  std::vector<uint8_t> data;
+  if (!cache_dir_.empty()) {
+    ReadBinaryFile(std::filesystem::path(cache_dir_) / kPipelineCacheFile,
+                   &data);
+  }
+
+  // Drivers are required to reject foreign caches, checking the header
+  // anyway keeps a stale file from another GPU out of the driver.
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device_->PhysicalDevice().Handle(),
+                                &properties);
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() >= sizeof(header)) {
+    std::memcpy(&header, data.data(), sizeof(header));
+  }
+  if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      header.vendorID != properties.vendorID ||
+      header.deviceID != properties.deviceID ||
+      std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                  VK_UUID_SIZE) != 0) {
+    data.clear();
+  }
+  pipeline_cache_warm_ = !data.empty();
+
+  VkPipelineCacheCreateInfo create_info{};
+  create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  create_info.initialDataSize = data.size();
+  create_info.pInitialData = data.data();
+  if (vkCreatePipelineCache(device_->Handle(), &create_info, nullptr,
+                            &pipeline_cache_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline cache.");
+  }
+}
+
+void DeviceContext::DestroyPipelineCache() {
+  if (pipeline_cache_ == VK_NULL_HANDLE) {
+    return;
+  }
+  if (!cache_dir_.empty()) {
+    size_t size = 0;
+    vkGetPipelineCacheData(device_->Handle(), pipeline_cache_, &size, nullptr);
+    std::vector<uint8_t> data(size);
+    if (size && vkGetPipelineCacheData(device_->Handle(), pipeline_cache_,
+                                       &size, data.data()) == VK_SUCCESS) {
+      WriteBinaryFile(std::filesystem::path(cache_dir_) / kPipelineCacheFile,
+                      data.data(), size);
+    }
+  }
+  vkDestroyPipelineCache(device_->Handle(), pipeline_cache_, nullptr);
+  pipeline_cache_ = VK_NULL_HANDLE;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "map"
+#include "mutex"
+#include "utils.h"
+
+class TextureImage;
+class UploadBatch;
+
+// Device-level objects shared by every Application view in the process:
+// the instance, the logical device with its graphics and transfer queues,
+// the persistent pipeline cache, the entity sampler and textures loaded
+// from files. A view only adds its window, swapchain and per-view buffers.
+class DeviceContext {
+ public:
+  // cache_dir holds the serialized pipeline cache, empty disables it.
+  explicit DeviceContext(std::string cache_dir = "cache");
+  ~DeviceContext();
+
+  [[nodiscard]] vulkan::Instance *Instance() const {
+    return instance_.get();
+  }
+
+  // Creates the device on the first call, picking one that can present to
+  // surface unless it is null. Every later call is a no-op, so windowed
+  // views have to be created before headless ones.
+  void CreateDevice(vulkan::Surface *surface);
+
+  [[nodiscard]] const std::shared_ptr<vulkan::Device> &Device() const {
+    return device_;
+  }
+  [[nodiscard]] const std::shared_ptr<vulkan::Queue> &GraphicsQueue() const {
+    return graphics_queue_;
+  }
+  [[nodiscard]] const std::shared_ptr<vulkan::Queue> &TransferQueue() const {
+    return transfer_queue_;
+  }
+  // For one-off uploads on the transfer queue from the main thread.
+  [[nodiscard]] const vulkan::CommandPool *TransferCommandPool() const {
+    return transfer_command_pool_.get();
+  }
+  [[nodiscard]] VkPipelineCache PipelineCache() const {
+    return pipeline_cache_;
+  }
+  // Whether the pipeline cache started from a file of an earlier run.
+  [[nodiscard]] bool PipelineCacheWarm() const {
+    return pipeline_cache_warm_;
+  }
+  // Whether a memory type is both device local and host visible, as on
+  // integrated GPUs or through resizable BAR.
+  [[nodiscard]] bool HostVisibleDeviceLocal() const {
+    return host_visible_device_local_;
+  }
+  [[nodiscard]] const vulkan::Sampler *EntitySampler() const {
+    return entity_sampler_.get();
+  }
+
+  // Loads the image file into a sampled texture once, later calls with the
+  // same path share it. A new texture is uploaded with batch when given.
+  std::shared_ptr<TextureImage> LoadTexture(const std::string &path,
+                                            UploadBatch *batch = nullptr);
+
+ private:
+  void CreatePipelineCache();
+  void DestroyPipelineCache();
+
+  std::string cache_dir_;
+
+  std::shared_ptr<vulkan::Instance> instance_;
+  std::shared_ptr<vulkan::Device> device_;
+  std::shared_ptr<vulkan::Queue> graphics_queue_;
+  std::shared_ptr<vulkan::Queue> transfer_queue_;
+  std::unique_ptr<vulkan::CommandPool> transfer_command_pool_;
+
+  VkPipelineCache pipeline_cache_{VK_NULL_HANDLE};
+  bool pipeline_cache_warm_{false};
+  bool host_visible_device_local_{false};
+
+  std::unique_ptr<vulkan::Sampler> entity_sampler_;
+
+  std::mutex texture_mutex_;
+  std::map<std::string, std::shared_ptr<TextureImage>> textures_;
+};
@@ -0,0 +1,37 @@
+# Writes OUTPUT as a C++ fragment embedding the SPIR-V binaries in
+# SPIRV_FILES, a "|" separated list of paths under SPIRV_DIR, keyed by the
+# same "shaders/<name>" path GetShaderCode takes.
+string(REPLACE "|" ";" FILES "${SPIRV_FILES}")
+
+set(ARRAYS "")
+set(ENTRIES "")
+set(INDEX 0)
+foreach (FILE ${FILES})
+    file(RELATIVE_PATH BINARY ${SPIRV_DIR} ${FILE})
+    file(READ ${FILE} HEX HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+    string(REGEX REPLACE "\\.spv$" "" NAME "${BINARY}")
+    string(APPEND ARRAYS "const unsigned char kSPIRV${INDEX}[] = {${BYTES}};\n")
+    string(APPEND ENTRIES
+           "      {\"${NAME}\", {kSPIRV${INDEX}, sizeof(kSPIRV${INDEX})}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach ()
+
+file(WRITE ${OUTPUT}.tmp "// Generated by embed_spirv.cmake, do not edit.
+${ARRAYS}
+std::vector<uint32_t> GetShaderSPIRV(const std::string &path) {
+  static const std::map<std::string, std::pair<const unsigned char *, size_t>>
+      binaries = {
+${ENTRIES}      };
+  auto it = binaries.find(path);
+  if (it == binaries.end()) {
+    return {};
+  }
+  std::vector<uint32_t> spirv(it->second.second / sizeof(uint32_t));
+  std::memcpy(spirv.data(), it->second.first, it->second.second);
+  return spirv;
+}
+")
+# Leave the timestamp alone when nothing changed so app.cpp is not rebuilt.
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
@@ -1,18 +1,13 @@
 #pragma once
+#include "entity_uniform_arena.h"
 #include "model.h"
 #include "texture_image.h"
 
-struct EntityUniformObject {
-  glm::mat4 model_{};
-  glm::vec4 color_{1.0f};
-};
-
 class Entity {
  public:
   Entity(Application *app, Model *model, TextureImage *image);
 
-  ~Entity() {
-  }
+  ~Entity();
 
   void Render(VkCommandBuffer cmd_buffer,
               VkPipelineLayout pipeline_layout) const;
@@ -23,6 +18,7 @@ class Entity {
   Application *app_;
   Model *model_;
   TextureImage *image_;
-  std::unique_ptr<DynamicBuffer<EntityUniformObject>> entity_uniform_object_;
-  std::vector<std::unique_ptr<vulkan::DescriptorSet>> descriptor_sets_;
+  // Slot in the application's entity uniform arena.
+  uint32_t uniform_slot_;
+  const std::vector<std::unique_ptr<vulkan::DescriptorSet>> *descriptor_sets_;
 };
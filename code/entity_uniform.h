@@ -0,0 +1,7 @@
+#pragma once
+#include "glm/glm.hpp"
+
+struct EntityUniformObject {
+  glm::mat4 model_{};
+  glm::vec4 color_{1.0f};
+};
@@ -0,0 +1,106 @@
+#include "entity_uniform_arena.h"
+
+#include "algorithm"
+#include "cstring"
+#include "functional"
+#include "stdexcept"
+
+EntityUniformArena::EntityUniformArena(Application *app, uint32_t capacity)
+    : app_(app) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(app_->Device()->PhysicalDevice().Handle(),
+                                &properties);
+  VkDeviceSize alignment = std::max<VkDeviceSize>(
+      properties.limits.minUniformBufferOffsetAlignment, 1);
+  stride_ = uint32_t((sizeof(EntityUniformObject) + alignment - 1) /
+                     alignment * alignment);
+  buffer_ = std::make_unique<DynamicBuffer<uint8_t>>(
+      app_, size_t(stride_) * capacity);
+  free_slots_.resize(capacity);
+  for (uint32_t i = 0; i < capacity; i++) {
+    free_slots_[i] = capacity - 1 - i;
+  }
+}
+
+EntityUniformArena::~EntityUniformArena() {
+  // Only destroyed with the device idle, the sets are freed right away.
+  texture_sets_.clear();
+  buffer_.reset();
+}
+
+uint32_t EntityUniformArena::Allocate() {
+  if (free_slots_.empty()) {
+    throw std::runtime_error("Entity uniform arena is full.");
+  }
+  uint32_t slot = free_slots_.back();
+  free_slots_.pop_back();
+  return slot;
+}
+
+void EntityUniformArena::Free(uint32_t slot) {
+  free_slots_.insert(std::upper_bound(free_slots_.begin(), free_slots_.end(),
+                                      slot, std::greater<uint32_t>()),
+                     slot);
+}
+
+void EntityUniformArena::Set(uint32_t slot,
+                             const EntityUniformObject &object) {
+  // The whole stride is marked, so neighbouring slots merge into one copy.
+  std::memcpy(buffer_->Data(Offset(slot), stride_), &object, sizeof(object));
+}
+
+const std::vector<std::unique_ptr<vulkan::DescriptorSet>>
+    &EntityUniformArena::AcquireDescriptorSets(TextureImage *image) {
+  TextureSets &texture_sets = texture_sets_[image];
+  if (texture_sets.users++) {
+    return texture_sets.sets;
+  }
+  texture_sets.sets.resize(app_->MaxFramesInFlight());
+  for (uint32_t i = 0; i < app_->MaxFramesInFlight(); i++) {
+    auto &descriptor_set = texture_sets.sets[i];
+    app_->EntityDescriptorPool()->AllocateDescriptorSet(
+        app_->EntityDescriptorSetLayout()->Handle(), &descriptor_set);
+
+    VkDescriptorImageInfo image_info{};
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_info.imageView = image->GetImage()->ImageView();
+    image_info.sampler = VK_NULL_HANDLE;
+
+    VkDescriptorBufferInfo buffer_info{};
+    buffer_info.buffer = buffer_->GetBuffer(i)->Handle();
+    buffer_info.offset = 0;
+    buffer_info.range = sizeof(EntityUniformObject);
+
+    VkWriteDescriptorSet write_descriptor_sets[2] = {};
+    write_descriptor_sets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_sets[0].dstSet = descriptor_set->Handle();
+    write_descriptor_sets[0].dstBinding = 0;
+    write_descriptor_sets[0].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write_descriptor_sets[0].descriptorCount = 1;
+    write_descriptor_sets[0].pImageInfo = &image_info;
+
+    write_descriptor_sets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_sets[1].dstSet = descriptor_set->Handle();
+    write_descriptor_sets[1].dstBinding = 1;
+    write_descriptor_sets[1].descriptorType =
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write_descriptor_sets[1].descriptorCount = 1;
+    write_descriptor_sets[1].pBufferInfo = &buffer_info;
+
+    vkUpdateDescriptorSets(app_->Device()->Handle(), 2, write_descriptor_sets,
+                           0, nullptr);
+  }
+  return texture_sets.sets;
+}
+
+void EntityUniformArena::ReleaseDescriptorSets(TextureImage *image) {
+  auto it = texture_sets_.find(image);
+  if (it == texture_sets_.end() || --it->second.users) {
+    return;
+  }
+  for (auto &descriptor_set : it->second.sets) {
+    app_->Retire(std::move(descriptor_set));
+  }
+  texture_sets_.erase(it);
+}
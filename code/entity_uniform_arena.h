@@ -0,0 +1,43 @@
+#pragma once
+#include "buffer.h"
+#include "entity_uniform.h"
+#include "map"
+#include "texture_image.h"
+
+// Uniforms of every entity of an application packed into one dynamic
+// buffer, at a stride that is a valid dynamic offset. Entities sharing a
+// texture share its descriptor sets and bind their slot with a dynamic
+// offset, so neighbouring slots sync in one merged copy.
+class EntityUniformArena {
+ public:
+  EntityUniformArena(Application *app, uint32_t capacity);
+  ~EntityUniformArena();
+
+  // Returns the lowest free slot, throws when every slot is taken.
+  uint32_t Allocate();
+  void Free(uint32_t slot);
+  void Set(uint32_t slot, const EntityUniformObject &object);
+
+  [[nodiscard]] uint32_t Offset(uint32_t slot) const {
+    return slot * stride_;
+  }
+
+  // Per-frame descriptor sets binding image and the arena, created by the
+  // first acquire of image and freed by its last release.
+  const std::vector<std::unique_ptr<vulkan::DescriptorSet>>
+      &AcquireDescriptorSets(TextureImage *image);
+  void ReleaseDescriptorSets(TextureImage *image);
+
+ private:
+  struct TextureSets {
+    uint32_t users{};
+    std::vector<std::unique_ptr<vulkan::DescriptorSet>> sets;
+  };
+
+  Application *app_;
+  uint32_t stride_;
+  std::unique_ptr<DynamicBuffer<uint8_t>> buffer_;
+  // Sorted from the highest slot down, so slots are handed out in order.
+  std::vector<uint32_t> free_slots_;
+  std::map<TextureImage *, TextureSets> texture_sets_;
+};
@@ -1,9 +1,5 @@
 #include "font_factory.h"
 
-namespace {
-#include "built_in_shaders.inl"
-}
-
 FontFactory::FontFactory(Application *app) : app_(app) {
   auto device = app_->Device();
   FT_Init_FreeType(&library_);
@@ -13,8 +9,10 @@ FontFactory::FontFactory(Application *app) : app_(app) {
 FontFactory::~FontFactory() {
   for (auto &font : loaded_fonts_) {
     for (auto &font_model : font.second) {
-      delete font_model.second.font_texture_;
-      delete font_model.second.font_texture_descriptor_set_;
+      app_->Retire(std::unique_ptr<vulkan::DescriptorSet>(
+          font_model.second.font_texture_descriptor_set_));
+      app_->Retire(
+          std::unique_ptr<TextureImage>(font_model.second.font_texture_));
     }
   }
 
@@ -40,61 +38,78 @@ void FontFactory::SetFont(const std::string &font_path, uint32_t size) {
   activate_font_set_ = &loaded_fonts_[{activate_face_, activate_size_}];
 }
 
-FontModel FontFactory::LoadChar(char c) {
-  if (!activate_font_set_->count(c)) {
+const FontModel &FontFactory::LoadChar(char c) {
+  auto it = activate_font_set_->find(c);
+  if (it == activate_font_set_->end()) {
     FT_Set_Pixel_Sizes(activate_face_, 0, activate_size_);
     FT_Load_Char(activate_face_, c, FT_LOAD_RENDER);
     auto glyph = activate_face_->glyph;
     auto bitmap = glyph->bitmap;
     auto width = bitmap.width;
     auto height = bitmap.rows;
-    auto image = Image(width, height, bitmap.buffer);
-    TextureImage *texture_image = nullptr;
-    vulkan::DescriptorSet *descriptor_set{nullptr};
 
+    auto font_model = FontModel{nullptr,
+                                nullptr,
+                                float(glyph->metrics.horiBearingX) / 64.0f,
+                                float(glyph->metrics.horiBearingY) / 64.0f,
+                                float(glyph->metrics.horiAdvance) / 64.0f,
+                                width,
+                                height};
+    it = activate_font_set_->insert({c, font_model}).first;
     if (width && height) {
-      texture_image = new TextureImage(app_, image);
-      font_descriptor_pool_->AllocateDescriptorSet(
-          font_image_descriptor_set_layout_->Handle(), &descriptor_set);
-
-      VkDescriptorImageInfo image_info{};
-      image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      image_info.imageView = texture_image->GetImage()->ImageView();
-      image_info.sampler = app_->EntitySampler()->Handle();
-
-      VkWriteDescriptorSet write_descriptor_set{};
-      write_descriptor_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      write_descriptor_set.dstSet = descriptor_set->Handle();
-      write_descriptor_set.dstBinding = 0;
-      write_descriptor_set.dstArrayElement = 0;
-      write_descriptor_set.descriptorType =
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      write_descriptor_set.descriptorCount = 1;
-      write_descriptor_set.pImageInfo = &image_info;
-
-      vkUpdateDescriptorSets(app_->Device()->Handle(), 1, &write_descriptor_set,
-                             0, nullptr);
+      pending_glyphs_.emplace_back(&it->second,
+                                   Image(width, height, bitmap.buffer));
     }
+  }
+  return it->second;
+}
 
-    auto font_model = FontModel{texture_image, descriptor_set,
-                                float(glyph->metrics.horiBearingX) / 64.0f,
-                                float(glyph->metrics.horiBearingY) / 64.0f,
-                                float(glyph->metrics.horiAdvance) / 64.0f};
-    activate_font_set_->insert({c, font_model});
+void FontFactory::UploadPendingGlyphs() {
+  if (pending_glyphs_.empty()) {
+    return;
+  }
+  // Every glyph first rasterized this frame shares one submit.
+  UploadBatch batch(app_->Context());
+  for (auto &pending_glyph : pending_glyphs_) {
+    FontModel *font_model = pending_glyph.first;
+    auto texture_image = new TextureImage(app_, pending_glyph.second, &batch);
+    vulkan::DescriptorSet *descriptor_set{nullptr};
+    font_descriptor_pool_->AllocateDescriptorSet(
+        font_image_descriptor_set_layout_->Handle(), &descriptor_set);
+
+    VkDescriptorImageInfo image_info{};
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_info.imageView = texture_image->GetImage()->ImageView();
+    image_info.sampler = app_->EntitySampler()->Handle();
+
+    VkWriteDescriptorSet write_descriptor_set{};
+    write_descriptor_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_set.dstSet = descriptor_set->Handle();
+    write_descriptor_set.dstBinding = 0;
+    write_descriptor_set.dstArrayElement = 0;
+    write_descriptor_set.descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write_descriptor_set.descriptorCount = 1;
+    write_descriptor_set.pImageInfo = &image_info;
+
+    vkUpdateDescriptorSets(app_->Device()->Handle(), 1, &write_descriptor_set,
+                           0, nullptr);
+
+    font_model->font_texture_ = texture_image;
+    font_model->font_texture_descriptor_set_ = descriptor_set;
   }
-  return activate_font_set_->at(c);
+  batch.Submit();
+  batch.Wait();
+  pending_glyphs_.clear();
 }
 
 void FontFactory::CreateFontPipeline() {
   auto device = app_->Device();
-  IgnoreResult(device->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/font.vert"),
-                                 VK_SHADER_STAGE_VERTEX_BIT),
-      &font_vertex_shader_));
-  IgnoreResult(device->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/font.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &font_fragment_shader_));
+  StartupTask vertex = app_->CreateShaderModuleAsync(
+      "shaders/font.vert", VK_SHADER_STAGE_VERTEX_BIT, &font_vertex_shader_);
+  StartupTask fragment = app_->CreateShaderModuleAsync(
+      "shaders/font.frag", VK_SHADER_STAGE_FRAGMENT_BIT,
+      &font_fragment_shader_);
 
   IgnoreResult(device->CreateDescriptorSetLayout(
       {{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT},
@@ -166,43 +181,50 @@ void FontFactory::CreateFontPipeline() {
       },
       &font_pipeline_layout_));
 
-  vulkan::PipelineSettings settings{app_->RenderPass(),
-                                    font_pipeline_layout_.get(), 0};
-  settings.AddShaderStage(font_vertex_shader_.get(),
-                          VK_SHADER_STAGE_VERTEX_BIT);
-  settings.AddShaderStage(font_fragment_shader_.get(),
-                          VK_SHADER_STAGE_FRAGMENT_BIT);
-  settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-  settings.SetBlendState(
-      0, VkPipelineColorBlendAttachmentState{
-             VK_TRUE,
-             VK_BLEND_FACTOR_ONE,
-             VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-             VK_BLEND_OP_ADD,
-             VK_BLEND_FACTOR_ONE,
-             VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-             VK_BLEND_OP_ADD,
-             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                 VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-         });
-  settings.SetCullMode(VK_CULL_MODE_NONE);
-  settings.SetMultiSampleState(VK_SAMPLE_COUNT_1_BIT);
-
-  IgnoreResult(device->CreatePipeline(settings, &font_pipeline_));
+  app_->RunAtStartup(
+      [this]() {
+        vulkan::PipelineSettings settings{app_->RenderPass(),
+                                          font_pipeline_layout_.get(), 0};
+        settings.AddShaderStage(font_vertex_shader_.get(),
+                                VK_SHADER_STAGE_VERTEX_BIT);
+        settings.AddShaderStage(font_fragment_shader_.get(),
+                                VK_SHADER_STAGE_FRAGMENT_BIT);
+        settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        settings.SetBlendState(
+            0, VkPipelineColorBlendAttachmentState{
+                   VK_TRUE,
+                   VK_BLEND_FACTOR_ONE,
+                   VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                   VK_BLEND_OP_ADD,
+                   VK_BLEND_FACTOR_ONE,
+                   VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                   VK_BLEND_OP_ADD,
+                   VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                       VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+               });
+        settings.SetCullMode(VK_CULL_MODE_NONE);
+        settings.SetMultiSampleState(VK_SAMPLE_COUNT_1_BIT);
+
+        IgnoreResult(app_->CreateGraphicsPipeline(settings, &font_pipeline_));
+      },
+      {vertex, fragment});
 }
 
 void FontFactory::DestroyFontPipeline() {
-  font_pipeline_.reset();
-  font_pipeline_layout_.reset();
+  app_->Retire(std::move(font_pipeline_));
+  app_->Retire(std::move(font_pipeline_layout_));
 
+  for (auto &descriptor_set : font_descriptor_sets_) {
+    app_->Retire(std::move(descriptor_set));
+  }
   font_descriptor_sets_.clear();
 
   global_transform_buffer_.reset();
   global_font_info_buffer_.reset();
 
-  font_descriptor_pool_.reset();
-  font_image_descriptor_set_layout_.reset();
-  font_global_descriptor_set_layout_.reset();
+  app_->Retire(std::move(font_descriptor_pool_));
+  app_->Retire(std::move(font_image_descriptor_set_layout_));
+  app_->Retire(std::move(font_global_descriptor_set_layout_));
 
   font_vertex_shader_.reset();
   font_fragment_shader_.reset();
@@ -213,12 +235,17 @@ void FontFactory::ClearDrawCalls() {
 }
 
 void FontFactory::CompileFontDrawCalls() {
+  UploadPendingGlyphs();
   std::sort(font_infos_.begin(), font_infos_.end());
-  FontInfo *font_info_data = global_font_info_buffer_->Data();
+  FontInfo *font_info_data =
+      global_font_info_buffer_->Data(0, font_infos_.size());
+  render_descriptor_sets_.resize(font_infos_.size());
   for (int i = 0; i < font_infos_.size(); i++) {
     font_info_data[i] = font_infos_[i].font_info;
+    render_descriptor_sets_[i] =
+        font_infos_[i].font_model->font_texture_descriptor_set_;
   }
-  VkExtent2D extent = app_->Swapchain()->Extent();
+  VkExtent2D extent = app_->FrameExtent();
   // clang-format off
   global_transform_buffer_->At(0) = glm::mat4{
       2.0f / float(extent.width), 0.0f, 0.0f, 0.0f,
@@ -228,25 +255,29 @@ void FontFactory::CompileFontDrawCalls() {
   // clang-format on
 }
 
-void FontFactory::Render(VkCommandBuffer cmd_buffer) {
-  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    font_pipeline_->Handle());
-  VkDescriptorSet descriptor_sets[] = {
-      font_descriptor_sets_[app_->CurrentFrame()]->Handle(),
-  };
-  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          font_pipeline_layout_->Handle(), 0, 1,
-                          descriptor_sets, 0, nullptr);
-  for (size_t i = 0; i < font_infos_.size(); i++) {
-    auto font_info = font_infos_[i];
-    if (font_info.desc_set) {
-      descriptor_sets[0] = font_info.desc_set->Handle();
-      vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              font_pipeline_layout_->Handle(), 1, 1,
-                              descriptor_sets, 0, nullptr);
-      vkCmdDraw(cmd_buffer, 6, 1, 0, i);
-    }
-  }
+VkCommandBuffer FontFactory::Render(VkCommandBuffer cmd_buffer) {
+  return app_->RecordInParallel(
+      cmd_buffer, render_descriptor_sets_.size(),
+      [this](VkCommandBuffer cmd_buffer, size_t begin, size_t end) {
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          font_pipeline_->Handle());
+        VkDescriptorSet descriptor_sets[] = {
+            font_descriptor_sets_[app_->CurrentFrame()]->Handle(),
+        };
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                font_pipeline_layout_->Handle(), 0, 1,
+                                descriptor_sets, 0, nullptr);
+        for (size_t i = begin; i < end; i++) {
+          if (render_descriptor_sets_[i]) {
+            descriptor_sets[0] = render_descriptor_sets_[i]->Handle();
+            vkCmdBindDescriptorSets(
+                cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                font_pipeline_layout_->Handle(), 1, 1, descriptor_sets, 0,
+                nullptr);
+            vkCmdDraw(cmd_buffer, 6, 1, 0, i);
+          }
+        }
+      });
 }
 
 void FontFactory::DrawText(glm::vec2 pos,
@@ -254,15 +285,11 @@ void FontFactory::DrawText(glm::vec2 pos,
                            const glm::vec3 &color,
                            float depth) {
   for (auto c : text) {
-    auto font = LoadChar(c);
-    VkExtent2D extent{};
-    if (font.font_texture_) {
-      extent = font.font_texture_->GetImage()->Extent();
-    }
+    auto &font = LoadChar(c);
     font_infos_.push_back({{{pos.x + font.bearing_x_, pos.y - font.bearing_y_,
-                             extent.width, extent.height},
+                             font.width_, font.height_},
                             {color.r, color.g, color.b, depth}},
-                           font.font_texture_descriptor_set_});
+                           &font});
     pos.x += font.advance_x_;
   }
 }
@@ -270,7 +297,7 @@ void FontFactory::DrawText(glm::vec2 pos,
 float FontFactory::GetTextWidth(const std::string &text) {
   float result = 0.0f;
   for (auto c : text) {
-    auto font = LoadChar(c);
+    auto &font = LoadChar(c);
     result += font.advance_x_;
   }
   return result;
@@ -13,6 +13,8 @@ struct FontModel {
   float bearing_x_{};
   float bearing_y_{};
   float advance_x_{};
+  uint32_t width_{};
+  uint32_t height_{};
 };
 
 struct FontInfo {
@@ -22,7 +24,7 @@ struct FontInfo {
 
 struct FontDrawCalls {
   FontInfo font_info;
-  vulkan::DescriptorSet *desc_set;
+  const FontModel *font_model;
   bool operator<(const FontDrawCalls &other) const {
     return font_info.color_depth.w > other.font_info.color_depth.w;
   }
@@ -35,12 +37,17 @@ class FontFactory {
 
   void SetFont(const std::string &font_path, uint32_t size);
 
-  FontModel LoadChar(char c);
+  // Layout only, glyph textures are created by CompileFontDrawCalls. Safe to
+  // call from the simulation thread.
+  const FontModel &LoadChar(char c);
 
   void ClearDrawCalls();
+  // Main thread, uploads new glyphs and publishes the draw calls to Render.
   void CompileFontDrawCalls();
 
-  void Render(VkCommandBuffer cmd_buffer);
+  // Returns the command buffer to continue recording into, see
+  // Application::RecordInParallel.
+  VkCommandBuffer Render(VkCommandBuffer cmd_buffer);
 
   void DrawText(glm::vec2 pos,
                 const std::string &text,
@@ -52,6 +59,7 @@ class FontFactory {
  private:
   void CreateFontPipeline();
   void DestroyFontPipeline();
+  void UploadPendingGlyphs();
 
   Application *app_;
 
@@ -76,7 +84,9 @@ class FontFactory {
   std::unique_ptr<vulkan::PipelineLayout> font_pipeline_layout_;
   std::unique_ptr<vulkan::Pipeline> font_pipeline_;
 
+  std::vector<std::pair<FontModel *, Image>> pending_glyphs_;
   std::vector<FontDrawCalls> font_infos_;
+  std::vector<vulkan::DescriptorSet *> render_descriptor_sets_;
   std::unique_ptr<DynamicBuffer<glm::mat4>> global_transform_buffer_;
   std::unique_ptr<DynamicBuffer<FontInfo>> global_font_info_buffer_;
 };
@@ -0,0 +1,62 @@
+#include "host_utils.h"
+
+#include "algorithm"
+#include "fmt/format.h"
+#include "fstream"
+#include "functional"
+#include "thread"
+
+double Percentile(const std::vector<double> &sorted, double p) {
+  size_t rank = size_t(p * double(sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+std::string SeriesToJson(std::vector<double> samples) {
+  samples.erase(std::remove_if(samples.begin(), samples.end(),
+                               [](double sample) { return sample < 0.0; }),
+                samples.end());
+  if (samples.empty()) {
+    return "null";
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  return fmt::format(
+      "{{\"mean\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, "
+      "\"max\": {:.4f}}}",
+      sum / double(samples.size()), Percentile(samples, 0.50),
+      Percentile(samples, 0.95), Percentile(samples, 0.99), samples.back());
+}
+
+bool ReadBinaryFile(const std::filesystem::path &path,
+                    std::vector<uint8_t> *data) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  data->resize(file.tellg());
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(data->data()), data->size());
+  return bool(file);
+}
+
+void WriteBinaryFile(const std::filesystem::path &path,
+                     const void *data,
+                     size_t size) {
+  std::error_code error;
+  std::filesystem::create_directories(path.parent_path(), error);
+  // Per thread, so writers racing on one path never share a temporary.
+  auto temp_path = path;
+  temp_path += fmt::format(
+      ".{:x}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return;
+    }
+    file.write(static_cast<const char *>(data), size);
+  }
+  std::filesystem::rename(temp_path, path, error);
+}
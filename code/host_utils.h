@@ -0,0 +1,21 @@
+#pragma once
+#include "cstdint"
+#include "filesystem"
+#include "string"
+#include "vector"
+
+// Nearest-rank percentile of non-empty samples sorted in ascending order.
+double Percentile(const std::vector<double> &sorted, double p);
+
+// JSON object with the mean, p50, p95, p99 and max of the non-negative
+// samples, "null" when there are none.
+std::string SeriesToJson(std::vector<double> samples);
+
+bool ReadBinaryFile(const std::filesystem::path &path,
+                    std::vector<uint8_t> *data);
+// Writes data to a temporary file next to path and renames it over path, so
+// a crash never leaves a truncated file behind. Missing parent directories
+// are created. Failures are ignored, callers only use it for caches.
+void WriteBinaryFile(const std::filesystem::path &path,
+                     const void *data,
+                     size_t size);
@@ -1,4 +1,6 @@
 #include "image.h"
+
+#include "stdexcept"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
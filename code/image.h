@@ -1,5 +1,7 @@
 #pragma once
-#include "utils.h"
+#include "cstdint"
+#include "string"
+#include "vector"
 
 struct ImagePixel {
   uint8_t r;
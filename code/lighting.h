@@ -2,24 +2,18 @@
 #include "app.h"
 #include "buffer.h"
 #include "entity.h"
-
-struct LightingGlobalUniformObject {
-  glm::mat4 proj;
-  glm::mat4 world;
-  glm::vec4 directional_light_direction;
-  glm::vec4 directional_light_color;
-  glm::vec4 specular_light;
-  glm::vec4 ambient_light_color;
-};
+#include "lighting_scene.h"
+#include "pipeline_variants.h"
 
 class Lighting : public Application {
  public:
-  Lighting();
+  explicit Lighting(const ApplicationSettings &settings = {});
 
  private:
   void OnInitImpl() override;
   void OnShutdownImpl() override;
   void OnUpdateImpl() override;
+  void OnSnapshotImpl() override;
   void OnRenderImpl(VkCommandBuffer cmd_buffer) override;
 
   void CreateEntityPipelineAssets();
@@ -30,13 +24,14 @@ class Lighting : public Application {
   void DestroyGlobalAssets();
   void DestroyEntities();
 
-  void OnKeyEvent(int key, int scancode, int action, int mods);
-  void OnScroll(double xoffset, double yoffset);
+  void OnKeyImpl(int key, int scancode, int action, int mods) override;
+  void OnScrollImpl(double xoffset, double yoffset) override;
 
   std::shared_ptr<vulkan::ShaderModule> entity_vert_shader_;
   std::shared_ptr<vulkan::ShaderModule> entity_frag_shader_;
   std::shared_ptr<vulkan::PipelineLayout> entity_pipeline_layout_;
-  std::shared_ptr<vulkan::Pipeline> entity_pipeline_;
+  // Keyed by whether the specular term is on.
+  std::unique_ptr<PipelineVariantCache> entity_pipelines_;
 
   std::unique_ptr<Model> model_;
   std::unique_ptr<Model> face_model_;
@@ -52,7 +47,8 @@ class Lighting : public Application {
   std::unique_ptr<DynamicBuffer<LightingGlobalUniformObject>>
       global_uniform_buffer_;
 
-  LightingGlobalUniformObject global_uniform_object_;
+  LightingGlobalUniformObject global_uniform_object_{};
+  EntityUniformObject entity_info_;
 
   float light_theta_{glm::radians(60.0f)};
   float light_phi_{glm::radians(30.0f)};
@@ -62,7 +58,15 @@ class Lighting : public Application {
   float camera_phi_{};
 
   glm::vec3 camera_position_{0.0f, 0.0f, 2.0f};
+  glm::vec3 last_step_move_{0.0f};
   bool smoothed_model_{true};
+  bool render_smoothed_model_{true};
+  bool specular_{true};
+  bool render_specular_{true};
+
+  bool cursor_sampled_{false};
+  double last_cursor_x_{};
+  double last_cursor_y_{};
 
   glm::mat4 model_transform_{1.0f};
 };
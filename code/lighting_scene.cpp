@@ -0,0 +1,76 @@
+#include "lighting_scene.h"
+
+#include "cmath"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+glm::vec3 hsv2rgb(const glm::vec3 &hsv) {
+  float h = hsv.x * 360.0f;  // scale hue to [0, 360)
+  float s = hsv.y;
+  float v = hsv.z;
+
+  float c = v * s;  // chroma
+  float x = c * (1.0f - std::fabs(std::fmod(h / 60.0f, 2) - 1.0f));
+  float m = v - c;
+
+  float r = 0.0f, g = 0.0f, b = 0.0f;
+
+  if (h >= 0 && h < 60) {
+    r = c, g = x, b = 0;
+  } else if (h >= 60 && h < 120) {
+    r = x, g = c, b = 0;
+  } else if (h >= 120 && h < 180) {
+    r = 0, g = c, b = x;
+  } else if (h >= 180 && h < 240) {
+    r = 0, g = x, b = c;
+  } else if (h >= 240 && h < 300) {
+    r = x, g = 0, b = c;
+  } else if (h >= 300 && h < 360) {
+    r = c, g = 0, b = x;
+  }
+
+  glm::vec3 rgb(r + m, g + m, b + m);
+  return rgb;
+}
+}  // namespace
+
+LightingGlobalUniformObject MakeLightingGlobals(
+    const glm::mat4 &camera_transform,
+    float light_theta,
+    float light_phi,
+    float aspect) {
+  glm::vec3 light_dir = glm::vec3(
+      glm::cos(light_theta) * glm::cos(light_phi), glm::sin(light_phi),
+      glm::sin(light_theta) * glm::cos(light_phi));
+
+  LightingGlobalUniformObject globals{};
+  globals.proj = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 10.0f);
+  globals.world = glm::inverse(camera_transform);
+  globals.directional_light_direction =
+      glm::normalize(glm::vec4(light_dir, 0.0f));
+  globals.directional_light_color = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
+  globals.ambient_light_color = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+  globals.specular_light = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
+  return globals;
+}
+
+glm::vec4 LightingEntityColor(float light_h) {
+  return glm::vec4{hsv2rgb(glm::vec3{light_h, 0.7f, 1.0f}), 1.0f};
+}
+
+glm::mat4 InitialLightingModelTransform() {
+  return glm::rotate(glm::mat4(1.0f), glm::radians(90.0f),
+                     glm::vec3(1.0f, 0.0f, 0.0f)) *
+         glm::rotate(glm::mat4(1.0f), glm::radians(90.0f),
+                     glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void InitialLightingScene(float aspect,
+                          LightingGlobalUniformObject *globals,
+                          EntityUniformObject *entity) {
+  *globals = MakeLightingGlobals(
+      glm::translate(glm::mat4(1.0f), glm::vec3{0.0f, 0.0f, 2.0f}),
+      glm::radians(60.0f), glm::radians(30.0f), aspect);
+  *entity = EntityUniformObject{InitialLightingModelTransform(),
+                                LightingEntityColor(0.0f)};
+}
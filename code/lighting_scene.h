@@ -0,0 +1,31 @@
+#pragma once
+#include "entity_uniform.h"
+#include "glm/glm.hpp"
+
+struct LightingGlobalUniformObject {
+  glm::mat4 proj;
+  glm::mat4 world;
+  glm::vec4 directional_light_direction;
+  glm::vec4 directional_light_color;
+  glm::vec4 specular_light;
+  glm::vec4 ambient_light_color;
+};
+
+// Exponent of the specular term, lighting.frag is specialized to it.
+constexpr float kLightingShininess = 32.0f;
+
+// Uniforms for a camera placed by camera_transform and a light coming from
+// the light_theta/light_phi direction.
+LightingGlobalUniformObject MakeLightingGlobals(
+    const glm::mat4 &camera_transform,
+    float light_theta,
+    float light_phi,
+    float aspect);
+// Model tint for the light hue light_h in [0, 1).
+glm::vec4 LightingEntityColor(float light_h);
+glm::mat4 InitialLightingModelTransform();
+// The scene as Lighting shows it before any input, for the renderers that
+// run without the app.
+void InitialLightingScene(float aspect,
+                          LightingGlobalUniformObject *globals,
+                          EntityUniformObject *entity);
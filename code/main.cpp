@@ -1,10 +1,148 @@
 #include "bezier.h"
+#include "filesystem"
 #include "lighting.h"
 #include "snow.h"
 #include "solar_system.h"
 #include "spiral.h"
+#include "sstream"
 
-int main() {
-  Lighting app;
-  app.Run();
+namespace {
+std::unique_ptr<Application> CreateDemo(const std::string &name,
+                                        const ApplicationSettings &settings) {
+  if (name == "lighting") {
+    return std::make_unique<Lighting>(settings);
+  } else if (name == "solar_system") {
+    return std::make_unique<SolarSystem>(settings);
+  } else if (name == "bezier") {
+    return std::make_unique<Bezier>(settings);
+  } else if (name == "snow") {
+    return std::make_unique<SnowSystem>(settings);
+  } else if (name == "spiral") {
+    return std::make_unique<SpiralSystem>(settings);
+  }
+  throw std::runtime_error("Unknown demo: " + name);
+}
+
+// path with "_<name>" appended to its stem, so the views of a multi-demo
+// run write files of their own.
+std::string ViewPath(const std::string &path, const std::string &name) {
+  if (path.empty()) {
+    return path;
+  }
+  std::filesystem::path view_path(path);
+  view_path.replace_filename(view_path.stem().string() + "_" + name +
+                             view_path.extension().string());
+  return view_path.string();
+}
+
+VkPresentModeKHR ParsePresentMode(const std::string &name) {
+  if (name == "fifo") {
+    return VK_PRESENT_MODE_FIFO_KHR;
+  } else if (name == "mailbox") {
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  } else if (name == "immediate") {
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  }
+  throw std::runtime_error("Unknown present mode: " + name);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  ApplicationSettings settings;
+  std::string demo = "lighting";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--demo") {
+      demo = next();
+    } else if (arg == "--headless") {
+      settings.headless = true;
+    } else if (arg == "--width") {
+      settings.extent.width = std::stoul(next());
+    } else if (arg == "--height") {
+      settings.extent.height = std::stoul(next());
+    } else if (arg == "--frames") {
+      settings.frame_count = std::stoull(next());
+    } else if (arg == "--dump-interval") {
+      settings.dump_interval = std::stoull(next());
+    } else if (arg == "--dump-path") {
+      settings.dump_path = next();
+    } else if (arg == "--trace") {
+      settings.trace_path = next();
+    } else if (arg == "--copy-present") {
+      settings.direct_present = false;
+    } else if (arg == "--staged-buffers") {
+      settings.direct_dynamic_buffers = false;
+    } else if (arg == "--pipelined") {
+      settings.pipelined = true;
+    } else if (arg == "--fixed-timestep") {
+      settings.fixed_timestep = std::stod(next());
+    } else if (arg == "--record-threads") {
+      settings.record_threads = std::stoul(next());
+    } else if (arg == "--cache-dir") {
+      settings.cache_dir = next();
+    } else if (arg == "--present-mode") {
+      settings.present_mode = ParsePresentMode(next());
+    } else if (arg == "--frames-in-flight") {
+      settings.frames_in_flight = std::stoul(next());
+    } else if (arg == "--frame-budget") {
+      settings.frame_budget_ms = std::stod(next());
+    } else if (arg == "--min-render-scale") {
+      settings.min_render_scale = std::stof(next());
+    } else if (arg == "--max-render-scale") {
+      settings.max_render_scale = std::stof(next());
+    } else if (arg == "--on-demand") {
+      settings.on_demand = true;
+    } else if (arg == "--max-entities") {
+      settings.max_entities = std::stoul(next());
+    } else if (arg == "--startup-threads") {
+      settings.startup_threads = std::stoul(next());
+    } else if (arg == "--record") {
+      settings.record_path = next();
+    } else if (arg == "--replay") {
+      settings.replay_path = next();
+    } else if (arg == "--seed") {
+      settings.seed = std::stoul(next());
+    } else if (arg == "--verbose") {
+      settings.verbose = true;
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+
+  // A comma separated list opens one view per demo on a shared device.
+  std::vector<std::string> demos;
+  std::stringstream demo_list(demo);
+  for (std::string name; std::getline(demo_list, name, ',');) {
+    demos.push_back(name);
+  }
+  if (demos.size() == 1) {
+    auto app = CreateDemo(demo, settings);
+    app->Run();
+    return 0;
+  }
+
+  if (!settings.record_path.empty() || !settings.replay_path.empty()) {
+    throw std::runtime_error("Recording and replay need a single demo.");
+  }
+  settings.on_demand = false;
+  settings.device_context = std::make_shared<DeviceContext>(settings.cache_dir);
+  std::vector<std::unique_ptr<Application>> apps;
+  std::vector<Application *> views;
+  for (auto &name : demos) {
+    // The shared context owns the pipeline cache and SPIR-V cache entries
+    // are content addressed, only the per-view outputs need names apart.
+    ApplicationSettings view_settings = settings;
+    view_settings.window_title = settings.window_title + " - " + name;
+    view_settings.dump_path = ViewPath(settings.dump_path, name);
+    view_settings.trace_path = ViewPath(settings.trace_path, name);
+    apps.push_back(CreateDemo(name, view_settings));
+    views.push_back(apps.back().get());
+  }
+  RunViews(views);
 }
@@ -0,0 +1,103 @@
+#include "mesh.h"
+
+#include "stdexcept"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+Mesh LoadSmoothedMesh(const std::string &path) {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                        path.c_str())) {
+    throw std::runtime_error(warn + err);
+  }
+
+  Mesh mesh;
+  auto &vertices = mesh.vertices;
+  auto &indices = mesh.indices;
+  for (const auto &shape : shapes) {
+    vertices.resize(attrib.vertices.size() / 3);
+    for (size_t i = 0; i < attrib.vertices.size(); i += 3) {
+      Vertex vertex{};
+      vertex.pos = {attrib.vertices[i], attrib.vertices[i + 1],
+                    attrib.vertices[i + 2]};
+      vertex.normal = {0.0f, 0.0f, 0.0f};
+      vertex.color = {1.0f, 1.0f, 1.0f};
+      vertex.tex_coord = {0.5f, 0.5f};
+      vertices[i / 3] = vertex;
+    }
+    indices.resize(shape.mesh.indices.size());
+    for (size_t i = 0; i < shape.mesh.indices.size(); i++) {
+      indices[i] = shape.mesh.indices[i].vertex_index;
+    }
+  }
+
+  std::vector<float> normal_accumulator(vertices.size(), 0.0f);
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    glm::vec3 v0 = vertices[indices[i]].pos;
+    glm::vec3 v1 = vertices[indices[i + 1]].pos;
+    glm::vec3 v2 = vertices[indices[i + 2]].pos;
+    glm::vec3 normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+    float weight = glm::length(glm::cross(v1 - v0, v2 - v0));
+    for (size_t j = i; j < i + 3; j++) {
+      vertices[indices[j]].normal += normal * weight;
+      normal_accumulator[indices[j]] += weight;
+    }
+  }
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    if (normal_accumulator[i] > 0.0f) {
+      vertices[i].normal /= normal_accumulator[i];
+    }
+  }
+  return mesh;
+}
+
+Mesh FlatShadedMesh(const Mesh &mesh) {
+  Mesh faces;
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    glm::vec3 v0 = mesh.vertices[mesh.indices[i]].pos;
+    glm::vec3 v1 = mesh.vertices[mesh.indices[i + 1]].pos;
+    glm::vec3 v2 = mesh.vertices[mesh.indices[i + 2]].pos;
+    glm::vec3 normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+    for (size_t j = i; j < i + 3; j++) {
+      Vertex vertex = mesh.vertices[mesh.indices[j]];
+      vertex.normal = normal;
+      faces.vertices.push_back(vertex);
+      faces.indices.push_back(j);
+    }
+  }
+  return faces;
+}
+
+Mesh CreateSphereMesh(int precision) {
+  const float inv_precision = 1.0f / float(precision);
+  Mesh mesh;
+  for (int i = 0; i <= precision; i++) {
+    float phi = glm::pi<float>() * float(i) * inv_precision;
+    for (int j = 0; j < precision + 1; j++) {
+      float theta = 2.0f * glm::pi<float>() * float(j) * inv_precision;
+      glm::vec3 pos = glm::vec3{glm::cos(theta) * glm::sin(phi), glm::cos(phi),
+                                -glm::sin(theta) * glm::sin(phi)};
+      glm::vec3 normal = glm::normalize(pos);
+      glm::vec3 color = glm::vec3{1.0f, 1.0f, 1.0f};
+      glm::vec2 tex_coord =
+          glm::vec2{float(j) * inv_precision, float(i) * inv_precision};
+      mesh.vertices.push_back({pos, normal, color, tex_coord});
+
+      if (i && j) {
+        int i1 = i - 1;
+        int j1 = j - 1;
+        mesh.indices.push_back(i1 * (precision + 1) + j);
+        mesh.indices.push_back(i1 * (precision + 1) + j1);
+        mesh.indices.push_back(i * (precision + 1) + j);
+        mesh.indices.push_back(i1 * (precision + 1) + j1);
+        mesh.indices.push_back(i * (precision + 1) + j1);
+        mesh.indices.push_back(i * (precision + 1) + j);
+      }
+    }
+  }
+  return mesh;
+}
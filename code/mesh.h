@@ -0,0 +1,22 @@
+#pragma once
+#include "cstdint"
+#include "string"
+#include "vector"
+#include "vertex.h"
+
+// Indexed triangle list on the CPU, shared by the Vulkan models and the
+// software rasterizer.
+struct Mesh {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// Loads an OBJ file, with vertex normals averaged from the adjacent faces
+// weighted by their area.
+Mesh LoadSmoothedMesh(const std::string &path);
+
+// Gives every triangle its own vertices with the face normal.
+Mesh FlatShadedMesh(const Mesh &mesh);
+
+// Unit sphere with precision rings and segments.
+Mesh CreateSphereMesh(int precision);
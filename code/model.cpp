@@ -2,10 +2,19 @@
 
 Model::Model(Application *app,
              const std::vector<Vertex> &vertices,
-             const std::vector<uint32_t> &indices)
+             const std::vector<uint32_t> &indices,
+             UploadBatch *batch)
     : app_(app) {
   vertex_buffer_ = std::make_unique<StaticBuffer<Vertex>>(app, vertices.size());
   index_buffer_ = std::make_unique<StaticBuffer<uint32_t>>(app, indices.size());
-  vertex_buffer_->Upload(vertices);
-  index_buffer_->Upload(indices);
+  if (batch) {
+    vertex_buffer_->Upload(vertices, batch);
+    index_buffer_->Upload(indices, batch);
+    return;
+  }
+  UploadBatch own_batch(app->Context(), 0);
+  vertex_buffer_->Upload(vertices, &own_batch);
+  index_buffer_->Upload(indices, &own_batch);
+  own_batch.Submit();
+  own_batch.Wait();
 }
@@ -1,20 +1,16 @@
 #pragma once
 #include "app.h"
 #include "buffer.h"
-#include "glm/glm.hpp"
-
-struct Vertex {
-  glm::vec3 pos;
-  glm::vec3 normal;
-  glm::vec3 color;
-  glm::vec2 tex_coord;
-};
+#include "vertex.h"
 
 class Model {
  public:
+  // Both buffers are uploaded with batch, or in one submit of their own
+  // when it is null.
   Model(Application *app,
         const std::vector<Vertex> &vertices,
-        const std::vector<uint32_t> &indices);
+        const std::vector<uint32_t> &indices,
+        UploadBatch *batch = nullptr);
 
   [[nodiscard]] Buffer *VertexBuffer() const {
     return vertex_buffer_.get();
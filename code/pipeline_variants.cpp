@@ -0,0 +1,61 @@
+#include "pipeline_variants.h"
+
+#include "stdexcept"
+
+void SpecializationConstants::Apply(vulkan::PipelineSettings *settings) {
+  info_.mapEntryCount = entries_.size();
+  info_.pMapEntries = entries_.data();
+  info_.dataSize = data_.size() * sizeof(uint32_t);
+  info_.pData = data_.data();
+  for (auto &stage : settings->shader_stage_create_infos) {
+    stage.pSpecializationInfo = entries_.empty() ? nullptr : &info_;
+  }
+}
+
+PipelineVariantCache::PipelineVariantCache(
+    Application *app,
+    vulkan::PipelineLayout *pipeline_layout,
+    Builder builder)
+    : app_(app),
+      pipeline_layout_(pipeline_layout),
+      builder_(std::move(builder)) {
+}
+
+void PipelineVariantCache::Prepare(uint64_t key,
+                                   std::vector<StartupTask> dependencies) {
+  app_->RunAtStartup([this, key]() { Get(key); },
+                     std::move(dependencies));
+}
+
+vulkan::Pipeline *PipelineVariantCache::Get(uint64_t key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pipelines_.find(key);
+    if (it != pipelines_.end()) {
+      return it->second.get();
+    }
+  }
+  // Created unlocked so that different variants build concurrently. A
+  // variant requested twice at once is built twice and the loser dropped.
+  std::shared_ptr<vulkan::Pipeline> pipeline = Create(key);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pipelines_.emplace(key, std::move(pipeline)).first->second.get();
+}
+
+size_t PipelineVariantCache::VariantCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pipelines_.size();
+}
+
+std::shared_ptr<vulkan::Pipeline> PipelineVariantCache::Create(
+    uint64_t key) const {
+  vulkan::PipelineSettings settings(app_->RenderPass(), pipeline_layout_, 0);
+  SpecializationConstants constants;
+  builder_(key, &settings, &constants);
+  constants.Apply(&settings);
+  std::shared_ptr<vulkan::Pipeline> pipeline;
+  if (app_->CreateGraphicsPipeline(settings, &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline variant.");
+  }
+  return pipeline;
+}
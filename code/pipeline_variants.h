@@ -0,0 +1,71 @@
+#pragma once
+#include "app.h"
+#include "cstring"
+#include "map"
+#include "mutex"
+#include "type_traits"
+
+// Values for a shader's specialization constants, shared by every stage of
+// a pipeline. Only 32-bit constants (bool, int, uint and float) are
+// supported.
+class SpecializationConstants {
+ public:
+  template <class T>
+  SpecializationConstants &Set(uint32_t constant_id, T value) {
+    static_assert(sizeof(T) <= sizeof(uint32_t));
+    uint32_t data{};
+    if constexpr (std::is_same_v<T, bool>) {
+      // GLSL booleans are 32 bits wide.
+      data = value ? VK_TRUE : VK_FALSE;
+    } else {
+      std::memcpy(&data, &value, sizeof(value));
+    }
+    entries_.push_back({constant_id,
+                        uint32_t(data_.size() * sizeof(uint32_t)),
+                        sizeof(uint32_t)});
+    data_.push_back(data);
+    return *this;
+  }
+
+  // Points every shader stage added to settings so far at these constants,
+  // which must stay alive until the pipeline is created.
+  void Apply(vulkan::PipelineSettings *settings);
+
+ private:
+  std::vector<VkSpecializationMapEntry> entries_;
+  std::vector<uint32_t> data_;
+  VkSpecializationInfo info_{};
+};
+
+// Pipelines sharing a layout and shader modules but differing in fixed
+// function state and specialization constants. Each variant is named by a
+// key chosen by the owner and created the first time it is needed.
+class PipelineVariantCache {
+ public:
+  // Fills in the shader stages, state and constants of the key's variant.
+  using Builder = std::function<void(uint64_t key,
+                                     vulkan::PipelineSettings *settings,
+                                     SpecializationConstants *constants)>;
+
+  PipelineVariantCache(Application *app,
+                       vulkan::PipelineLayout *pipeline_layout,
+                       Builder builder);
+
+  // Creates the variant ahead of its first use as a startup task, once the
+  // shader modules it depends on exist.
+  void Prepare(uint64_t key, std::vector<StartupTask> dependencies = {});
+
+  // Returns the variant, creating it on the calling thread if no one has.
+  vulkan::Pipeline *Get(uint64_t key);
+
+  [[nodiscard]] size_t VariantCount();
+
+ private:
+  std::shared_ptr<vulkan::Pipeline> Create(uint64_t key) const;
+
+  Application *app_{};
+  vulkan::PipelineLayout *pipeline_layout_{};
+  Builder builder_;
+  std::mutex mutex_;
+  std::map<uint64_t, std::shared_ptr<vulkan::Pipeline>> pipelines_;
+};
@@ -0,0 +1,78 @@
+#include "profiler.h"
+
+namespace {
+constexpr uint32_t kGpuThreadId = 0;
+}
+
+Profiler::Profiler(const std::string &path)
+    : file_(path), start_(std::chrono::steady_clock::now()) {
+  if (!file_) {
+    throw std::runtime_error("Failed to open trace file: " + path);
+  }
+  file_ << "{\"traceEvents\":[\n";
+  file_ << R"({"name":"process_name","ph":"M","pid":0,"tid":0,)"
+        << R"("args":{"name":"FCG HW6"}})";
+  WriteThreadName(kGpuThreadId, "GPU");
+}
+
+Profiler::~Profiler() {
+  file_ << "\n]}\n";
+}
+
+double Profiler::NowUs() const {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start_)
+      .count();
+}
+
+void Profiler::AddCpuEvent(const char *name, double begin_us, double end_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WriteEvent(name, "cpu", ThreadId(), begin_us, end_us - begin_us);
+}
+
+void Profiler::AddGpuEvent(const char *name, double begin_us, double end_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WriteEvent(name, "gpu", kGpuThreadId, begin_us, end_us - begin_us);
+}
+
+void Profiler::WriteEvent(const char *name,
+                          const char *category,
+                          uint32_t tid,
+                          double begin_us,
+                          double duration_us) {
+  file_ << fmt::format(
+      ",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":0,"
+      "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+      name, category, tid, begin_us, duration_us);
+}
+
+void Profiler::WriteThreadName(uint32_t tid, const std::string &name) {
+  file_ << fmt::format(
+      ",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},"
+      "\"args\":{{\"name\":\"{}\"}}}}",
+      tid, name);
+}
+
+uint32_t Profiler::ThreadId() {
+  auto it = thread_ids_.find(std::this_thread::get_id());
+  if (it != thread_ids_.end()) {
+    return it->second;
+  }
+  uint32_t tid = thread_ids_.size() + 1;
+  thread_ids_[std::this_thread::get_id()] = tid;
+  WriteThreadName(tid, tid == 1 ? "Main" : fmt::format("Worker {}", tid - 1));
+  return tid;
+}
+
+ProfileScope::ProfileScope(Profiler *profiler, const char *name)
+    : profiler_(profiler), name_(name) {
+  if (profiler_) {
+    begin_us_ = profiler_->NowUs();
+  }
+}
+
+ProfileScope::~ProfileScope() {
+  if (profiler_) {
+    profiler_->AddCpuEvent(name_, begin_us_, profiler_->NowUs());
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "chrono"
+#include "fstream"
+#include "map"
+#include "mutex"
+#include "thread"
+#include "utils.h"
+
+// Streams timing zones as Chrome trace events (chrome://tracing, Perfetto).
+// Timestamps are microseconds since the profiler was created.
+class Profiler {
+ public:
+  explicit Profiler(const std::string &path);
+  ~Profiler();
+
+  [[nodiscard]] double NowUs() const;
+
+  void AddCpuEvent(const char *name, double begin_us, double end_us);
+  void AddGpuEvent(const char *name, double begin_us, double end_us);
+
+ private:
+  void WriteEvent(const char *name,
+                  const char *category,
+                  uint32_t tid,
+                  double begin_us,
+                  double duration_us);
+  void WriteThreadName(uint32_t tid, const std::string &name);
+  uint32_t ThreadId();
+
+  std::mutex mutex_;
+  std::ofstream file_;
+  std::chrono::steady_clock::time_point start_;
+  std::map<std::thread::id, uint32_t> thread_ids_;
+};
+
+class ProfileScope {
+ public:
+  // A null profiler makes the scope a no-op.
+  ProfileScope(Profiler *profiler, const char *name);
+  ~ProfileScope();
+
+ private:
+  Profiler *profiler_;
+  const char *name_;
+  double begin_us_{};
+};
@@ -0,0 +1,62 @@
+#include "chrono"
+#include "fmt/format.h"
+#include "reference_renderer.h"
+#include "stdexcept"
+
+// Renders the Lighting scene as it starts up with the reference renderer,
+// for checking lighting.frag changes without a GPU.
+int main(int argc, char **argv) {
+  uint32_t width = 1280;
+  uint32_t height = 720;
+  uint32_t samples_per_axis = 4;
+  size_t threads = 0;
+  bool flat = false;
+  std::string output = "reference.png";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--width") {
+      width = std::stoul(next());
+    } else if (arg == "--height") {
+      height = std::stoul(next());
+    } else if (arg == "--samples") {
+      samples_per_axis = std::stoul(next());
+    } else if (arg == "--threads") {
+      threads = std::stoul(next());
+    } else if (arg == "--flat") {
+      flat = true;
+    } else if (arg == "--output") {
+      output = next();
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+
+  LightingGlobalUniformObject globals;
+  EntityUniformObject entity;
+  InitialLightingScene(float(width) / float(height), &globals, &entity);
+  Mesh mesh = LoadSmoothedMesh(ASSETS_PATH "meshes/eight.uniform.obj");
+  if (flat) {
+    mesh = FlatShadedMesh(mesh);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  ReferenceRenderer renderer(mesh, entity, threads);
+  auto render_start = std::chrono::steady_clock::now();
+  Image image = renderer.Render(globals, width, height, samples_per_axis);
+  auto end = std::chrono::steady_clock::now();
+  double build_ms =
+      std::chrono::duration<double, std::milli>(render_start - start).count();
+  double render_ms =
+      std::chrono::duration<double, std::milli>(end - render_start).count();
+  fmt::print("BVH build {:.2f} ms, render {:.2f} ms, {:.2f} Mrays/s\n",
+             build_ms, render_ms,
+             double(renderer.RayCount()) / (render_ms * 1000.0));
+  image.WriteToFile(output);
+  fmt::print("Wrote {}\n", output);
+}
@@ -0,0 +1,201 @@
+#include "reference_renderer.h"
+
+#include "algorithm"
+#include "glm/gtc/matrix_transform.hpp"
+#include "limits"
+
+namespace {
+constexpr uint32_t kTileSize = 16;
+
+uint8_t ToUnorm(float value) {
+  return uint8_t(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+}  // namespace
+
+ReferenceRenderer::ReferenceRenderer(const Mesh &mesh,
+                                     const EntityUniformObject &entity,
+                                     size_t thread_count)
+    : mesh_(mesh), color_(entity.color_), thread_count_(thread_count) {
+  glm::mat3 normal_transform =
+      glm::transpose(glm::inverse(glm::mat3(entity.model_)));
+  std::vector<glm::vec3> positions;
+  for (auto &vertex : mesh_.vertices) {
+    vertex.pos = glm::vec3(entity.model_ * glm::vec4{vertex.pos, 1.0f});
+    vertex.normal = glm::normalize(normal_transform * vertex.normal);
+    positions.push_back(vertex.pos);
+  }
+  bvh_ = std::make_unique<Bvh>(positions, mesh_.indices);
+
+  if (!thread_count_) {
+    thread_count_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (thread_count_ > 1) {
+    pool_ = std::make_unique<ThreadPool>(thread_count_);
+  }
+}
+
+Image ReferenceRenderer::Render(const LightingGlobalUniformObject &globals,
+                                uint32_t width,
+                                uint32_t height,
+                                uint32_t samples_per_axis) {
+  globals_ = globals;
+  eye_position_ = glm::vec3(glm::inverse(globals.world)[3]);
+  // Screen space to world space, undoing the shaders' y flip.
+  screen_to_world_ =
+      glm::inverse(glm::scale(glm::mat4{1.0f}, glm::vec3{1.0f, -1.0f, 1.0f}) *
+                   globals.proj * globals.world);
+  width_ = width;
+  height_ = height;
+  samples_per_axis_ = std::max(1u, samples_per_axis);
+  tiles_x_ = (width + kTileSize - 1) / kTileSize;
+  uint32_t tile_count = tiles_x_ * ((height + kTileSize - 1) / kTileSize);
+  ray_count_ = 0;
+
+  // Each worker starts on a contiguous run of tiles and steals from the far
+  // end of the other runs once its own is done, which balances the empty
+  // background tiles against the ones covering the model.
+  size_t worker_count = std::min<size_t>(thread_count_, tile_count);
+  worker_count = std::max<size_t>(worker_count, 1);
+  std::vector<TileQueue> queues(worker_count);
+  for (uint32_t tile = 0; tile < tile_count; tile++) {
+    queues[size_t(tile) * worker_count / tile_count].tiles.push_back(tile);
+  }
+
+  Image image(width, height);
+  auto work = [this, &queues, &image, worker_count](size_t worker) {
+    while (true) {
+      uint32_t tile = 0;
+      bool found = false;
+      for (size_t i = 0; i < worker_count && !found; i++) {
+        TileQueue &queue = queues[(worker + i) % worker_count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tiles.empty()) {
+          continue;
+        }
+        if (i == 0) {
+          tile = queue.tiles.front();
+          queue.tiles.pop_front();
+        } else {
+          tile = queue.tiles.back();
+          queue.tiles.pop_back();
+        }
+        found = true;
+      }
+      if (!found) {
+        return;
+      }
+      RenderTile(tile, &image);
+    }
+  };
+
+  if (!pool_ || worker_count == 1) {
+    work(0);
+    return image;
+  }
+  std::vector<std::future<void>> workers;
+  for (size_t worker = 0; worker < worker_count; worker++) {
+    workers.push_back(pool_->Submit([&work, worker]() { work(worker); }));
+  }
+  for (auto &worker : workers) {
+    worker.get();
+  }
+  return image;
+}
+
+void ReferenceRenderer::RenderTile(uint32_t tile, Image *image) const {
+  uint32_t x0 = tile % tiles_x_ * kTileSize;
+  uint32_t y0 = tile / tiles_x_ * kTileSize;
+  uint32_t x1 = std::min(x0 + kTileSize, width_);
+  uint32_t y1 = std::min(y0 + kTileSize, height_);
+  float sample_weight = 1.0f / float(samples_per_axis_ * samples_per_axis_);
+  uint64_t rays = 0;
+
+  // Packets cover 2x2 pixels at the same subsample, neighbouring rays hit
+  // the same nodes.
+  for (uint32_t y = y0; y < y1; y += 2) {
+    for (uint32_t x = x0; x < x1; x += 2) {
+      glm::vec3 colors[4] = {glm::vec3{0.0f}, glm::vec3{0.0f},
+                             glm::vec3{0.0f}, glm::vec3{0.0f}};
+      for (uint32_t sy = 0; sy < samples_per_axis_; sy++) {
+        for (uint32_t sx = 0; sx < samples_per_axis_; sx++) {
+          RayPacket packet{};
+          glm::vec3 directions[4];
+          for (int lane = 0; lane < 4; lane++) {
+            uint32_t px = x + lane % 2;
+            uint32_t py = y + lane / 2;
+            if (px >= x1 || py >= y1) {
+              continue;
+            }
+            float screen_x =
+                (float(px) + (float(sx) + 0.5f) / float(samples_per_axis_)) /
+                float(width_);
+            float screen_y =
+                (float(py) + (float(sy) + 0.5f) / float(samples_per_axis_)) /
+                float(height_);
+            // The far plane is at depth 1 in either clip convention.
+            glm::vec4 far_point =
+                screen_to_world_ * glm::vec4{screen_x * 2.0f - 1.0f,
+                                             screen_y * 2.0f - 1.0f, 1.0f,
+                                             1.0f};
+            glm::vec3 target = glm::vec3(far_point) / far_point.w;
+            directions[lane] = glm::normalize(target - eye_position_);
+            for (int axis = 0; axis < 3; axis++) {
+              packet.origin[axis][lane] = eye_position_[axis];
+              packet.direction[axis][lane] = directions[lane][axis];
+            }
+            packet.t_max[lane] = std::numeric_limits<float>::max();
+            rays++;
+          }
+          RayHit hits[4];
+          bvh_->Intersect(packet, hits);
+          for (int lane = 0; lane < 4; lane++) {
+            // Clamped per sample, like resolving a multisampled UNORM
+            // attachment.
+            if (hits[lane].triangle >= 0) {
+              colors[lane] += glm::clamp(Shade(hits[lane], directions[lane]),
+                                         0.0f, 1.0f);
+            }
+          }
+        }
+      }
+      for (int lane = 0; lane < 4; lane++) {
+        uint32_t px = x + lane % 2;
+        uint32_t py = y + lane / 2;
+        if (px >= x1 || py >= y1) {
+          continue;
+        }
+        glm::vec3 color = colors[lane] * sample_weight;
+        (*image)(px, py) = {ToUnorm(color.r), ToUnorm(color.g),
+                            ToUnorm(color.b), 255};
+      }
+    }
+  }
+  ray_count_ += rays;
+}
+
+glm::vec3 ReferenceRenderer::Shade(const RayHit &hit,
+                                   const glm::vec3 &direction) const {
+  const Vertex &v0 = mesh_.vertices[mesh_.indices[hit.triangle * 3]];
+  const Vertex &v1 = mesh_.vertices[mesh_.indices[hit.triangle * 3 + 1]];
+  const Vertex &v2 = mesh_.vertices[mesh_.indices[hit.triangle * 3 + 2]];
+  float w = 1.0f - hit.u - hit.v;
+  glm::vec3 normal =
+      glm::normalize(v0.normal * w + v1.normal * hit.u + v2.normal * hit.v);
+  glm::vec3 color = v0.color * w + v1.color * hit.u + v2.color * hit.v;
+  glm::vec3 pos = eye_position_ + direction * hit.t;
+
+  // lighting.frag with the Lighting entity's white texture.
+  glm::vec3 light_dir = glm::vec3(globals_.directional_light_direction);
+  glm::vec4 light_strength =
+      std::max(glm::dot(normal, light_dir), 0.0f) *
+          globals_.directional_light_color +
+      globals_.ambient_light_color;
+  light_strength.a = 1.0f;
+  glm::vec4 out_color = color_ * glm::vec4{color, 1.0f} * light_strength;
+  glm::vec3 view_dir = glm::normalize(eye_position_ - pos);
+  glm::vec3 reflect_dir = glm::reflect(-light_dir, normal);
+  out_color += std::pow(std::max(glm::dot(view_dir, reflect_dir), 0.0f),
+                        kLightingShininess) *
+               globals_.specular_light;
+  return glm::vec3(out_color);
+}
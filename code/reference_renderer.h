@@ -0,0 +1,57 @@
+#pragma once
+#include "atomic"
+#include "bvh.h"
+#include "image.h"
+#include "lighting_scene.h"
+#include "memory"
+#include "mesh.h"
+#include "thread_pool.h"
+
+// Ground truth for the Lighting scene. Every pixel averages a regular grid
+// of rays traced against a BVH of the mesh, each shaded like lighting.frag
+// at its closest hit, so only the rasterizer's sampling differs.
+class ReferenceRenderer {
+ public:
+  // The mesh is moved into world space by the entity's model matrix once.
+  // thread_count 0 uses every hardware thread.
+  ReferenceRenderer(const Mesh &mesh,
+                    const EntityUniformObject &entity,
+                    size_t thread_count);
+
+  // Renders samples_per_axis squared rays per pixel.
+  Image Render(const LightingGlobalUniformObject &globals,
+               uint32_t width,
+               uint32_t height,
+               uint32_t samples_per_axis);
+
+  // Rays traced by the last Render.
+  [[nodiscard]] uint64_t RayCount() const {
+    return ray_count_;
+  }
+
+ private:
+  struct TileQueue {
+    std::mutex mutex;
+    std::deque<uint32_t> tiles;
+  };
+
+  void RenderTile(uint32_t tile, Image *image) const;
+  [[nodiscard]] glm::vec3 Shade(const RayHit &hit,
+                                const glm::vec3 &direction) const;
+
+  Mesh mesh_;
+  glm::vec4 color_;
+  std::unique_ptr<Bvh> bvh_;
+  size_t thread_count_;
+  std::unique_ptr<ThreadPool> pool_;
+
+  // Per-render state read by the workers.
+  LightingGlobalUniformObject globals_{};
+  glm::mat4 screen_to_world_{1.0f};
+  glm::vec3 eye_position_{0.0f};
+  uint32_t width_{};
+  uint32_t height_{};
+  uint32_t tiles_x_{};
+  uint32_t samples_per_axis_{1};
+  mutable std::atomic<uint64_t> ray_count_{0};
+};
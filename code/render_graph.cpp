@@ -0,0 +1,250 @@
+#include "render_graph.h"
+
+namespace {
+struct UsageInfo {
+  VkImageLayout layout;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  VkImageUsageFlags usage;
+  bool write;
+  bool attachment;
+};
+
+UsageInfo DescribeUsage(ImageUsage usage) {
+  switch (usage) {
+    case ImageUsage::kColorAttachment:
+      return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+              true,
+              true};
+    case ImageUsage::kDepthAttachment:
+      return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+              true,
+              true};
+    case ImageUsage::kSampled:
+      return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_USAGE_SAMPLED_BIT,
+              false,
+              false};
+    case ImageUsage::kTransferSrc:
+      return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_READ_BIT,
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+              false,
+              false};
+    case ImageUsage::kTransferDst:
+      return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+              VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+              true,
+              false};
+  }
+  throw std::runtime_error("Unknown image usage.");
+}
+
+constexpr VkAccessFlags kWriteAccess =
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+}  // namespace
+
+RenderGraph::ImageId RenderGraph::AddExternalImage(
+    const std::string &name,
+    VkImageAspectFlags aspect,
+    VkPipelineStageFlags first_stage,
+    VkImageLayout final_layout) {
+  images_.push_back({name, aspect, true, first_stage, final_layout});
+  compiled_ = false;
+  return ImageId(images_.size() - 1);
+}
+
+RenderGraph::ImageId RenderGraph::AddTransientImage(const std::string &name,
+                                                    VkImageAspectFlags aspect) {
+  images_.push_back({name, aspect, false, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                     VK_IMAGE_LAYOUT_UNDEFINED});
+  compiled_ = false;
+  return ImageId(images_.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const std::string &name,
+                              std::vector<ImageAccess> accesses,
+                              RecordFunc record) {
+  passes_.push_back({name, std::move(accesses), std::move(record)});
+  compiled_ = false;
+  return uint32_t(passes_.size() - 1);
+}
+
+void RenderGraph::Compile() {
+  for (auto &image : images_) {
+    image.passes.clear();
+    image.last_stages = 0;
+    image.last_writes = 0;
+  }
+  for (uint32_t pass = 0; pass < passes_.size(); pass++) {
+    for (auto &access : passes_[pass].accesses) {
+      Image &image = images_.at(access.image);
+      if (!image.passes.empty() && image.passes.back() == pass) {
+        throw std::runtime_error("Pass " + passes_[pass].name +
+                                 " accesses image " + image.name + " twice.");
+      }
+      image.passes.push_back(pass);
+      UsageInfo info = DescribeUsage(access.usage);
+      // Everything since the last write has to finish before the next
+      // frame's first access reuses the image.
+      if (info.write) {
+        image.last_stages = 0;
+        image.last_writes = info.access & kWriteAccess;
+      }
+      image.last_stages |= info.stages;
+    }
+  }
+  states_.resize(images_.size());
+  compiled_ = true;
+}
+
+const RenderGraph::ImageAccess *RenderGraph::FindAccess(uint32_t pass,
+                                                        ImageId image) const {
+  for (auto &access : passes_.at(pass).accesses) {
+    if (access.image == image) {
+      return &access;
+    }
+  }
+  return nullptr;
+}
+
+VkAttachmentLoadOp RenderGraph::LoadOp(uint32_t pass, ImageId image) const {
+  const auto &passes = images_.at(image).passes;
+  if (!passes.empty() && passes.front() == pass) {
+    return VK_ATTACHMENT_LOAD_OP_CLEAR;
+  }
+  return VK_ATTACHMENT_LOAD_OP_LOAD;
+}
+
+VkAttachmentStoreOp RenderGraph::StoreOp(uint32_t pass, ImageId image) const {
+  const Image &info = images_.at(image);
+  bool read_later = !info.passes.empty() && info.passes.back() != pass;
+  bool presented = info.external &&
+                   info.final_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+  return read_later || presented ? VK_ATTACHMENT_STORE_OP_STORE
+                                 : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+}
+
+VkImageUsageFlags RenderGraph::UsageFlags(ImageId image) const {
+  const Image &info = images_.at(image);
+  VkImageUsageFlags usage = 0;
+  bool attachment_only = true;
+  for (uint32_t pass : info.passes) {
+    UsageInfo usage_info = DescribeUsage(FindAccess(pass, image)->usage);
+    usage |= usage_info.usage;
+    attachment_only = attachment_only && usage_info.attachment;
+  }
+  if (!info.external && info.passes.size() == 1 && attachment_only) {
+    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  }
+  return usage;
+}
+
+VkImageLayout RenderGraph::Layout(ImageUsage usage) {
+  return DescribeUsage(usage).layout;
+}
+
+void RenderGraph::SetImage(ImageId image, VkImage handle) {
+  images_.at(image).handle = handle;
+}
+
+void RenderGraph::Execute(VkCommandBuffer cmd_buffer) {
+  if (!compiled_) {
+    throw std::runtime_error("Render graph executed before Compile.");
+  }
+  for (auto &state : states_) {
+    state = {};
+  }
+
+  auto add_barrier = [this](const Image &image, VkImageLayout old_layout,
+                            VkImageLayout new_layout, VkAccessFlags src_access,
+                            VkAccessFlags dst_access) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image.handle;
+    barrier.subresourceRange.aspectMask = image.aspect;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barriers_.push_back(barrier);
+  };
+  auto flush_barriers = [this, cmd_buffer](VkPipelineStageFlags src_stages,
+                                           VkPipelineStageFlags dst_stages) {
+    if (barriers_.empty()) {
+      return;
+    }
+    vkCmdPipelineBarrier(cmd_buffer, src_stages, dst_stages, 0, 0, nullptr, 0,
+                         nullptr, barriers_.size(), barriers_.data());
+    barriers_.clear();
+  };
+
+  for (auto &pass : passes_) {
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    for (auto &access : pass.accesses) {
+      const Image &image = images_[access.image];
+      ImageState &state = states_[access.image];
+      UsageInfo info = DescribeUsage(access.usage);
+      if (state.accessed && !state.written && !info.write &&
+          state.layout == info.layout) {
+        // Reads after reads in the same layout need no barrier, later writes
+        // wait for all of them.
+        state.stages |= info.stages;
+        state.access |= info.access;
+        continue;
+      }
+      if (state.accessed) {
+        src_stages |= state.stages;
+        add_barrier(image, state.layout, info.layout,
+                    state.written ? state.access & kWriteAccess : 0,
+                    info.access);
+      } else {
+        // The previous contents are discarded, only the previous frame's
+        // accesses or the external producer have to be waited for.
+        src_stages |= image.external ? image.first_stage : image.last_stages;
+        add_barrier(image, VK_IMAGE_LAYOUT_UNDEFINED, info.layout,
+                    image.external ? 0 : image.last_writes, info.access);
+      }
+      dst_stages |= info.stages;
+      state = {true, info.layout, info.stages, info.access, info.write};
+    }
+    flush_barriers(src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                   dst_stages);
+    pass.record(cmd_buffer);
+  }
+
+  VkPipelineStageFlags src_stages = 0;
+  for (ImageId id = 0; id < images_.size(); id++) {
+    const Image &image = images_[id];
+    const ImageState &state = states_[id];
+    if (!image.external || image.final_layout == VK_IMAGE_LAYOUT_UNDEFINED ||
+        !state.accessed || state.layout == image.final_layout) {
+      continue;
+    }
+    src_stages |= state.stages;
+    add_barrier(image, state.layout, image.final_layout,
+                state.written ? state.access & kWriteAccess : 0, 0);
+  }
+  flush_barriers(src_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
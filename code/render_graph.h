@@ -0,0 +1,96 @@
+#pragma once
+#include "functional"
+#include "utils.h"
+
+enum class ImageUsage {
+  kColorAttachment,
+  kDepthAttachment,
+  kSampled,
+  kTransferSrc,
+  kTransferDst,
+};
+
+// The frame's passes, declared once together with the images they access.
+// Compile derives attachment load/store ops from the declarations and
+// Execute records the passes with the barriers between them.
+class RenderGraph {
+ public:
+  using ImageId = uint32_t;
+  using RecordFunc = std::function<void(VkCommandBuffer)>;
+
+  struct ImageAccess {
+    ImageId image;
+    ImageUsage usage;
+  };
+
+  // An image whose contents outlive the frame. Its first access in a frame
+  // waits for first_stage, e.g. the stage a semaphore wait unblocks, and the
+  // frame leaves it in final_layout.
+  ImageId AddExternalImage(const std::string &name,
+                           VkImageAspectFlags aspect,
+                           VkPipelineStageFlags first_stage,
+                           VkImageLayout final_layout);
+  // An image whose contents are only used within the frame.
+  ImageId AddTransientImage(const std::string &name,
+                            VkImageAspectFlags aspect);
+  // Passes execute in the order they are added. A pass accesses each image
+  // at most once.
+  uint32_t AddPass(const std::string &name,
+                   std::vector<ImageAccess> accesses,
+                   RecordFunc record);
+
+  void Compile();
+
+  // Attachments are cleared on their first access in the frame and only
+  // stored when a later pass or the next frame reads them.
+  [[nodiscard]] VkAttachmentLoadOp LoadOp(uint32_t pass, ImageId image) const;
+  [[nodiscard]] VkAttachmentStoreOp StoreOp(uint32_t pass,
+                                            ImageId image) const;
+  // Usage flags covering every access. Images that never leave the
+  // attachment memory of a single pass get TRANSIENT_ATTACHMENT, but they
+  // are still fully backed until their allocation can use lazily allocated
+  // memory.
+  [[nodiscard]] VkImageUsageFlags UsageFlags(ImageId image) const;
+  [[nodiscard]] static VkImageLayout Layout(ImageUsage usage);
+
+  // Binds the handle recorded by the next Execute.
+  void SetImage(ImageId image, VkImage handle);
+  void Execute(VkCommandBuffer cmd_buffer);
+
+ private:
+  struct Image {
+    std::string name;
+    VkImageAspectFlags aspect;
+    bool external;
+    VkPipelineStageFlags first_stage;
+    VkImageLayout final_layout;
+    VkImage handle{VK_NULL_HANDLE};
+    // Passes accessing the image, in execution order.
+    std::vector<uint32_t> passes;
+    // What the previous frame's accesses leave for the first access to wait
+    // on when the image is shared between frames.
+    VkPipelineStageFlags last_stages{};
+    VkAccessFlags last_writes{};
+  };
+  struct Pass {
+    std::string name;
+    std::vector<ImageAccess> accesses;
+    RecordFunc record;
+  };
+  struct ImageState {
+    bool accessed;
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    bool written;
+  };
+
+  [[nodiscard]] const ImageAccess *FindAccess(uint32_t pass,
+                                              ImageId image) const;
+
+  std::vector<Image> images_;
+  std::vector<Pass> passes_;
+  std::vector<ImageState> states_;
+  std::vector<VkImageMemoryBarrier> barriers_;
+  bool compiled_{false};
+};
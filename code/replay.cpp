@@ -0,0 +1,145 @@
+#include "replay.h"
+
+#include "algorithm"
+#include "stdexcept"
+
+namespace {
+constexpr char kReplayMagic[4] = {'F', 'C', 'G', 'R'};
+constexpr uint32_t kReplayVersion = 1;
+
+template <class T>
+void WriteValue(std::ofstream *file, const T &value) {
+  file->write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <class T>
+T ReadValue(std::ifstream *file) {
+  T value{};
+  file->read(reinterpret_cast<char *>(&value), sizeof(T));
+  return value;
+}
+}  // namespace
+
+ReplayWriter::ReplayWriter(const std::string &path,
+                           const ReplayHeader &header)
+    : file_(path, std::ios::binary | std::ios::trunc) {
+  if (!file_) {
+    throw std::runtime_error("Failed to open replay file " + path);
+  }
+  file_.write(kReplayMagic, sizeof(kReplayMagic));
+  WriteValue(&file_, kReplayVersion);
+  WriteValue(&file_, header.seed);
+  WriteValue(&file_, header.extent.width);
+  WriteValue(&file_, header.extent.height);
+}
+
+void ReplayWriter::Write(const ReplayFrame &frame) {
+  WriteValue(&file_, frame.delta_time);
+  WriteValue(&file_, frame.simulation_steps);
+  WriteValue(&file_, frame.interpolation_alpha);
+
+  uint8_t mouse_buttons = 0;
+  for (size_t button = 0; button < frame.input.mouse_buttons.size();
+       button++) {
+    if (frame.input.mouse_buttons[button]) {
+      mouse_buttons |= uint8_t(1u << button);
+    }
+  }
+  WriteValue(&file_, mouse_buttons);
+  WriteValue(&file_, frame.input.cursor_x);
+  WriteValue(&file_, frame.input.cursor_y);
+
+  uint16_t held_keys = 0;
+  for (auto key : frame.input.keys) {
+    held_keys += key ? 1 : 0;
+  }
+  WriteValue(&file_, held_keys);
+  for (size_t key = 0; key < frame.input.keys.size(); key++) {
+    if (frame.input.keys[key]) {
+      WriteValue(&file_, uint16_t(key));
+      WriteValue(&file_, frame.input.keys[key]);
+    }
+  }
+
+  WriteValue(&file_, uint16_t(frame.events.size()));
+  for (auto &event : frame.events) {
+    WriteValue(&file_, uint8_t(event.scroll));
+    if (event.scroll) {
+      WriteValue(&file_, event.xoffset);
+      WriteValue(&file_, event.yoffset);
+    } else {
+      WriteValue(&file_, int32_t(event.key));
+      WriteValue(&file_, int32_t(event.scancode));
+      WriteValue(&file_, int32_t(event.action));
+      WriteValue(&file_, int32_t(event.mods));
+    }
+  }
+  frame_count_++;
+}
+
+ReplayReader::ReplayReader(const std::string &path)
+    : file_(path, std::ios::binary) {
+  char magic[sizeof(kReplayMagic)]{};
+  file_.read(magic, sizeof(magic));
+  if (!file_ || !std::equal(magic, magic + sizeof(magic), kReplayMagic) ||
+      ReadValue<uint32_t>(&file_) != kReplayVersion) {
+    throw std::runtime_error("Not a replay file: " + path);
+  }
+  header_.seed = ReadValue<uint32_t>(&file_);
+  header_.extent.width = ReadValue<uint32_t>(&file_);
+  header_.extent.height = ReadValue<uint32_t>(&file_);
+  if (!file_) {
+    throw std::runtime_error("Truncated replay file " + path);
+  }
+}
+
+bool ReplayReader::AtEnd() {
+  return file_.peek() == std::ifstream::traits_type::eof();
+}
+
+bool ReplayReader::Read(ReplayFrame *frame) {
+  if (AtEnd()) {
+    return false;
+  }
+  frame->delta_time = ReadValue<float>(&file_);
+  frame->simulation_steps = ReadValue<uint32_t>(&file_);
+  frame->interpolation_alpha = ReadValue<float>(&file_);
+
+  frame->input = {};
+  auto mouse_buttons = ReadValue<uint8_t>(&file_);
+  for (size_t button = 0; button < frame->input.mouse_buttons.size();
+       button++) {
+    frame->input.mouse_buttons[button] = (mouse_buttons >> button) & 1;
+  }
+  frame->input.cursor_x = ReadValue<double>(&file_);
+  frame->input.cursor_y = ReadValue<double>(&file_);
+
+  auto held_keys = ReadValue<uint16_t>(&file_);
+  for (uint16_t i = 0; i < held_keys; i++) {
+    auto key = ReadValue<uint16_t>(&file_);
+    auto state = ReadValue<uint8_t>(&file_);
+    if (key < frame->input.keys.size()) {
+      frame->input.keys[key] = state;
+    }
+  }
+
+  frame->events.resize(ReadValue<uint16_t>(&file_));
+  for (auto &event : frame->events) {
+    event = {};
+    event.scroll = ReadValue<uint8_t>(&file_);
+    if (event.scroll) {
+      event.xoffset = ReadValue<double>(&file_);
+      event.yoffset = ReadValue<double>(&file_);
+    } else {
+      event.key = ReadValue<int32_t>(&file_);
+      event.scancode = ReadValue<int32_t>(&file_);
+      event.action = ReadValue<int32_t>(&file_);
+      event.mods = ReadValue<int32_t>(&file_);
+    }
+  }
+  if (!file_) {
+    throw std::runtime_error("Truncated replay file.");
+  }
+  frame_count_++;
+  return true;
+}
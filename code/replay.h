@@ -0,0 +1,71 @@
+#pragma once
+#include "array"
+#include "fstream"
+#include "utils.h"
+
+struct InputState {
+  std::array<uint8_t, GLFW_KEY_LAST + 1> keys{};
+  std::array<uint8_t, GLFW_MOUSE_BUTTON_LAST + 1> mouse_buttons{};
+  double cursor_x{};
+  double cursor_y{};
+};
+
+struct InputEvent {
+  bool scroll;
+  int key, scancode, action, mods;
+  double xoffset, yoffset;
+};
+
+// Everything a simulated frame reads from outside the application.
+struct ReplayFrame {
+  float delta_time{};
+  uint32_t simulation_steps{1};
+  float interpolation_alpha{1.0f};
+  InputState input;
+  std::vector<InputEvent> events;
+};
+
+// Run-wide state a replay has to start from.
+struct ReplayHeader {
+  uint32_t seed{};
+  VkExtent2D extent{};
+};
+
+// Binary log of a run, one record per simulated frame. Held keys are stored
+// as a list, so idle frames take a few dozen bytes.
+class ReplayWriter {
+ public:
+  ReplayWriter(const std::string &path, const ReplayHeader &header);
+
+  void Write(const ReplayFrame &frame);
+
+  [[nodiscard]] uint64_t FrameCount() const {
+    return frame_count_;
+  }
+
+ private:
+  std::ofstream file_;
+  uint64_t frame_count_{};
+};
+
+class ReplayReader {
+ public:
+  explicit ReplayReader(const std::string &path);
+
+  [[nodiscard]] const ReplayHeader &Header() const {
+    return header_;
+  }
+
+  // Returns false once every recorded frame has been read.
+  bool Read(ReplayFrame *frame);
+  [[nodiscard]] bool AtEnd();
+
+  [[nodiscard]] uint64_t FrameCount() const {
+    return frame_count_;
+  }
+
+ private:
+  std::ifstream file_;
+  ReplayHeader header_;
+  uint64_t frame_count_{};
+};
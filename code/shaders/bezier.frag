@@ -1,9 +1,17 @@
 #version 450
 
+layout(constant_id = 0) const bool kTextured = false;
+
 layout(location = 0) in vec2 tex_coord;
 
 layout(location = 0) out vec4 out_color;
 
+layout(binding = 1) uniform sampler2D tex;
+
 void main() {
-  out_color = vec4(1.0, 0.0, 0.0, 1.0);
+  if (kTextured) {
+    out_color = texture(tex, tex_coord);
+  } else {
+    out_color = vec4(1.0, 0.0, 0.0, 1.0);
+  }
 }
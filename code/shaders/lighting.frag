@@ -1,5 +1,8 @@
 #version 450
 
+layout(constant_id = 0) const bool kSpecular = true;
+layout(constant_id = 1) const float kShininess = 32.0;
+
 layout(location = 0) in vec3 frag_normal;
 layout(location = 1) in vec3 frag_color;
 layout(location = 2) in vec2 frag_tex_coord;
@@ -35,10 +38,12 @@ void main() {
   light_strenth.a = 1.0;
   out_color = entity.color * vec4(frag_color, 1.0) *
               texture(tex, frag_tex_coord) * light_strenth;
-  vec3 view_dir = normalize(inverse(camera.world)[3].xyz - frag_pos);
-  vec3 reflect_dir =
-      reflect(-camera.directional_light_direction.xyz, normalize(frag_normal));
-  out_color +=
-      pow(max(dot(view_dir, reflect_dir), 0.0), 32) * camera.specular_color;
+  if (kSpecular) {
+    vec3 view_dir = normalize(inverse(camera.world)[3].xyz - frag_pos);
+    vec3 reflect_dir = reflect(-camera.directional_light_direction.xyz,
+                               normalize(frag_normal));
+    out_color += pow(max(dot(view_dir, reflect_dir), 0.0), kShininess) *
+                 camera.specular_color;
+  }
   out_color.a = 1.0;
 }
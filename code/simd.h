@@ -0,0 +1,163 @@
+#pragma once
+#include "cstdint"
+#include "cstring"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include "emmintrin.h"
+#define SIMD_SSE
+#endif
+
+// Four floats operated on together, with SSE where available. Comparisons
+// return masks with every bit set in the lanes where they hold.
+struct Float4 {
+#ifdef SIMD_SSE
+  __m128 v;
+
+  static Float4 Splat(float value) {
+    return {_mm_set1_ps(value)};
+  }
+  static Float4 Load(const float *values) {
+    return {_mm_loadu_ps(values)};
+  }
+  void Store(float *values) const {
+    _mm_storeu_ps(values, v);
+  }
+  // Bit i is set when lane i of the mask is.
+  [[nodiscard]] int MoveMask() const {
+    return _mm_movemask_ps(v);
+  }
+
+  friend Float4 operator+(Float4 a, Float4 b) {
+    return {_mm_add_ps(a.v, b.v)};
+  }
+  friend Float4 operator-(Float4 a, Float4 b) {
+    return {_mm_sub_ps(a.v, b.v)};
+  }
+  friend Float4 operator*(Float4 a, Float4 b) {
+    return {_mm_mul_ps(a.v, b.v)};
+  }
+  friend Float4 operator/(Float4 a, Float4 b) {
+    return {_mm_div_ps(a.v, b.v)};
+  }
+  friend Float4 operator<(Float4 a, Float4 b) {
+    return {_mm_cmplt_ps(a.v, b.v)};
+  }
+  friend Float4 operator<=(Float4 a, Float4 b) {
+    return {_mm_cmple_ps(a.v, b.v)};
+  }
+  friend Float4 operator>(Float4 a, Float4 b) {
+    return {_mm_cmpgt_ps(a.v, b.v)};
+  }
+  friend Float4 operator>=(Float4 a, Float4 b) {
+    return {_mm_cmpge_ps(a.v, b.v)};
+  }
+  friend Float4 operator&(Float4 a, Float4 b) {
+    return {_mm_and_ps(a.v, b.v)};
+  }
+  friend Float4 operator|(Float4 a, Float4 b) {
+    return {_mm_or_ps(a.v, b.v)};
+  }
+  friend Float4 Min(Float4 a, Float4 b) {
+    return {_mm_min_ps(a.v, b.v)};
+  }
+  friend Float4 Max(Float4 a, Float4 b) {
+    return {_mm_max_ps(a.v, b.v)};
+  }
+  // Lanes of a where mask is set, of b elsewhere.
+  friend Float4 Select(Float4 mask, Float4 a, Float4 b) {
+    return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+  }
+#else
+  float v[4];
+
+  static Float4 Splat(float value) {
+    return {{value, value, value, value}};
+  }
+  static Float4 Load(const float *values) {
+    return {{values[0], values[1], values[2], values[3]}};
+  }
+  void Store(float *values) const {
+    std::memcpy(values, v, sizeof(v));
+  }
+  [[nodiscard]] int MoveMask() const {
+    int mask = 0;
+    for (int i = 0; i < 4; i++) {
+      uint32_t bits;
+      std::memcpy(&bits, &v[i], sizeof(bits));
+      mask |= int(bits >> 31) << i;
+    }
+    return mask;
+  }
+
+  template <class Fn>
+  static Float4 Map(Float4 a, Float4 b, Fn fn) {
+    Float4 result;
+    for (int i = 0; i < 4; i++) {
+      result.v[i] = fn(a.v[i], b.v[i]);
+    }
+    return result;
+  }
+  static float Mask(bool value) {
+    uint32_t bits = value ? ~0u : 0u;
+    float mask;
+    std::memcpy(&mask, &bits, sizeof(mask));
+    return mask;
+  }
+  static float Bits(float a, float b, uint32_t (*fn)(uint32_t, uint32_t)) {
+    uint32_t a_bits, b_bits;
+    std::memcpy(&a_bits, &a, sizeof(a_bits));
+    std::memcpy(&b_bits, &b, sizeof(b_bits));
+    uint32_t bits = fn(a_bits, b_bits);
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+
+  friend Float4 operator+(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return x + y; });
+  }
+  friend Float4 operator-(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return x - y; });
+  }
+  friend Float4 operator*(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return x * y; });
+  }
+  friend Float4 operator/(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return x / y; });
+  }
+  friend Float4 operator<(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return Mask(x < y); });
+  }
+  friend Float4 operator<=(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return Mask(x <= y); });
+  }
+  friend Float4 operator>(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return Mask(x > y); });
+  }
+  friend Float4 operator>=(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return Mask(x >= y); });
+  }
+  friend Float4 operator&(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) {
+      return Bits(x, y, [](uint32_t p, uint32_t q) { return p & q; });
+    });
+  }
+  friend Float4 operator|(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) {
+      return Bits(x, y, [](uint32_t p, uint32_t q) { return p | q; });
+    });
+  }
+  // Like minps/maxps, the second operand wins when either is NaN.
+  friend Float4 Min(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return x < y ? x : y; });
+  }
+  friend Float4 Max(Float4 a, Float4 b) {
+    return Map(a, b, [](float x, float y) { return x > y ? x : y; });
+  }
+  friend Float4 Select(Float4 mask, Float4 a, Float4 b) {
+    return (mask & a) | Map(mask, b, [](float x, float y) {
+             return Bits(x, y, [](uint32_t p, uint32_t q) { return ~p & q; });
+           });
+  }
+#endif
+};
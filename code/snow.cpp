@@ -1,10 +1,7 @@
 #include "snow.h"
 
-namespace {
-#include "built_in_shaders.inl"
-}
-
-SnowSystem::SnowSystem() : rd_() {
+SnowSystem::SnowSystem(const ApplicationSettings &settings)
+    : Application(settings), random_(Seed()) {
 }
 
 void SnowSystem::OnInitImpl() {
@@ -20,55 +17,64 @@ void SnowSystem::OnShutdownImpl() {
 }
 
 void SnowSystem::OnUpdateImpl() {
-  static auto last_time = std::chrono::high_resolution_clock::now();
-  auto current_time = std::chrono::high_resolution_clock::now();
-  float duration_s = std::chrono::duration<float, std::chrono::seconds::period>(
-                         current_time - last_time)
-                         .count();
-  last_time = current_time;
-  static float accumulated_time = 0.0f;
-  accumulated_time += duration_s;
-  static float generate_duration = 0.5f;
-  static float duration_scalar = 3.0f;
-  auto extent = Swapchain()->Extent();
+  MarkDirty();
+  float delta_t = DeltaTime();
+  auto extent = FrameExtent();
   float aspect = float(extent.width) / float(extent.height);
-  while (accumulated_time > generate_duration) {
-    SnowInfo snow_info{};
-    snow_info.position = {
-        std::uniform_real_distribution<float>(-aspect, aspect)(rd_), 1.0f};
-    snow_info.size = std::uniform_real_distribution<float>(0.05f, 0.25f)(rd_);
-    snow_info.position.y += snow_info.size;
-    snow_info.alpha = std::uniform_real_distribution<float>(0.5f, 1.0f)(rd_);
-    snow_info.velocity = {
-        0.0f, -std::uniform_real_distribution<float>(0.1f, 0.5f)(rd_)};
-    snow_infos_.push_back(snow_info);
-    accumulated_time -= generate_duration;
-    generate_duration = std::uniform_real_distribution<float>(0.1f, 0.5f)(rd_) *
-                        duration_scalar;
-    duration_scalar *= 0.95f;
-    if (duration_scalar < 0.5f) {
-      duration_scalar = 0.5f;
+  for (uint32_t step = 0; step < SimulationSteps(); step++) {
+    accumulated_time_ += delta_t;
+    while (accumulated_time_ > generate_duration_) {
+      SnowInfo snow_info{};
+      snow_info.position = {
+          std::uniform_real_distribution<float>(-aspect, aspect)(random_),
+          1.0f};
+      snow_info.size =
+          std::uniform_real_distribution<float>(0.05f, 0.25f)(random_);
+      snow_info.position.y += snow_info.size;
+      snow_info.alpha =
+          std::uniform_real_distribution<float>(0.5f, 1.0f)(random_);
+      snow_info.velocity = {
+          0.0f, -std::uniform_real_distribution<float>(0.1f, 0.5f)(random_)};
+      snow_infos_.push_back(snow_info);
+      accumulated_time_ -= generate_duration_;
+      generate_duration_ =
+          std::uniform_real_distribution<float>(0.1f, 0.5f)(random_) *
+          duration_scalar_;
+      duration_scalar_ *= 0.95f;
+      if (duration_scalar_ < 0.5f) {
+        duration_scalar_ = 0.5f;
+      }
     }
-  }
 
-  std::vector<SnowInfo> new_snow_infos;
-  std::vector<Snow> snows;
-  for (auto snow_info : snow_infos_) {
-    snow_info.position += snow_info.velocity * duration_s;
-    if (snow_info.position.y < -1.0f) {
-      continue;
-    }
-    snow_info.velocity.y -= 0.1f * duration_s;
-    if (snow_info.velocity.y < -1.0f) {
-      snow_info.velocity.y = -1.0f;
+    std::vector<SnowInfo> new_snow_infos;
+    for (auto snow_info : snow_infos_) {
+      snow_info.position += snow_info.velocity * delta_t;
+      if (snow_info.position.y < -1.0f) {
+        continue;
+      }
+      snow_info.velocity.y -= 0.1f * delta_t;
+      if (snow_info.velocity.y < -1.0f) {
+        snow_info.velocity.y = -1.0f;
+      }
+      new_snow_infos.push_back(snow_info);
     }
-    snows.push_back(snow_info.GetSnow());
-    new_snow_infos.push_back(snow_info);
+    snow_infos_ = new_snow_infos;
   }
 
-  snow_infos_ = new_snow_infos;
+  // Step back by the part of the last step that has not been reached yet.
+  float rewind = (1.0f - InterpolationAlpha()) * delta_t;
+  snows_.clear();
+  for (auto &snow_info : snow_infos_) {
+    Snow snow = snow_info.GetSnow();
+    snow.position -= snow_info.velocity * rewind;
+    snows_.push_back(snow);
+  }
+}
 
-  std::memcpy(snow_buffer_->Data(), snows.data(), sizeof(Snow) * snows.size());
+void SnowSystem::OnSnapshotImpl() {
+  std::memcpy(snow_buffer_->Data(0, snows_.size()), snows_.data(),
+              sizeof(Snow) * snows_.size());
+  snow_count_ = snows_.size();
 }
 
 void SnowSystem::OnRenderImpl(VkCommandBuffer cmd_buffer) {
@@ -89,7 +95,7 @@ void SnowSystem::OnRenderImpl(VkCommandBuffer cmd_buffer) {
   vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           pipeline_layout_->Handle(), 0, 1, &descriptor_set, 0,
                           nullptr);
-  vkCmdDraw(cmd_buffer, 6, snow_infos_.size(), 0, 0);
+  vkCmdDraw(cmd_buffer, 6, snow_count_, 0, 0);
 }
 
 void SnowSystem::CreateAssets() {
@@ -105,17 +111,17 @@ void SnowSystem::CreateAssets() {
       pixel.a = 255;
     }
   }
-  Image background;
-  background.ReadFromFile(ASSETS_PATH "texture/background.jpg");
-  snow_particle_image_ = std::make_shared<TextureImage>(this, snow_particle);
-  background_image_ = std::make_shared<TextureImage>(this, background);
+  snow_particle_image_ =
+      std::make_shared<TextureImage>(this, snow_particle, StartupUploads());
+  background_image_ =
+      LoadTexture(ASSETS_PATH "texture/background.jpg", StartupUploads());
 
   snow_buffer_ = std::make_shared<DynamicBuffer<Snow>>(this, 1024);
   global_uniform_buffer_ = std::make_shared<StaticBuffer<glm::mat4>>(this, 1);
-  auto extent = Swapchain()->Extent();
+  auto extent = FrameExtent();
   glm::mat4 transform = glm::mat4{1.0f};
   transform[0][0] = float(extent.height) / float(extent.width);
-  global_uniform_buffer_->Upload({transform});
+  global_uniform_buffer_->Upload({transform}, StartupUploads());
 }
 
 void SnowSystem::DestroyAssets() {
@@ -193,65 +199,71 @@ void SnowSystem::DestroyDescriptorAssets() {
 }
 
 void SnowSystem::CreatePipeline() {
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/snow.vert"),
-                                 VK_SHADER_STAGE_VERTEX_BIT),
-      &vertex_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/snow.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &fragment_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/background.vert"),
-                                 VK_SHADER_STAGE_VERTEX_BIT),
-      &background_vertex_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/background.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &background_fragment_shader_));
+  StartupTask vertex = CreateShaderModuleAsync(
+      "shaders/snow.vert", VK_SHADER_STAGE_VERTEX_BIT, &vertex_shader_);
+  StartupTask fragment = CreateShaderModuleAsync(
+      "shaders/snow.frag", VK_SHADER_STAGE_FRAGMENT_BIT, &fragment_shader_);
+  StartupTask background_vertex = CreateShaderModuleAsync(
+      "shaders/background.vert", VK_SHADER_STAGE_VERTEX_BIT,
+      &background_vertex_shader_);
+  StartupTask background_fragment = CreateShaderModuleAsync(
+      "shaders/background.frag", VK_SHADER_STAGE_FRAGMENT_BIT,
+      &background_fragment_shader_);
   IgnoreResult(Device()->CreatePipelineLayout(
       {descriptor_set_layout_->Handle()}, &pipeline_layout_));
-  vulkan::PipelineSettings pipeline_settings(RenderPass(),
-                                             pipeline_layout_.get());
-  pipeline_settings.AddShaderStage(vertex_shader_.get(),
-                                   VK_SHADER_STAGE_VERTEX_BIT);
-  pipeline_settings.AddShaderStage(fragment_shader_.get(),
-                                   VK_SHADER_STAGE_FRAGMENT_BIT);
-  pipeline_settings.AddInputBinding(0, sizeof(Snow),
-                                    VK_VERTEX_INPUT_RATE_INSTANCE);
-  pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32_SFLOAT,
-                                      offsetof(Snow, position));
-  pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32_SFLOAT,
-                                      offsetof(Snow, size));
-  pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32_SFLOAT,
-                                      offsetof(Snow, alpha));
-  pipeline_settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-  pipeline_settings.depth_stencil_state_create_info->depthTestEnable = VK_FALSE;
-  pipeline_settings.depth_stencil_state_create_info->depthWriteEnable =
-      VK_FALSE;
 
-  pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
-  pipeline_settings.SetBlendState(
-      0, {VK_TRUE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-          VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE,
-          VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_OP_ADD,
-          VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-              VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT});
+  RunAtStartup(
+      [this]() {
+        vulkan::PipelineSettings pipeline_settings(RenderPass(),
+                                                   pipeline_layout_.get());
+        pipeline_settings.AddShaderStage(vertex_shader_.get(),
+                                         VK_SHADER_STAGE_VERTEX_BIT);
+        pipeline_settings.AddShaderStage(fragment_shader_.get(),
+                                         VK_SHADER_STAGE_FRAGMENT_BIT);
+        pipeline_settings.AddInputBinding(0, sizeof(Snow),
+                                          VK_VERTEX_INPUT_RATE_INSTANCE);
+        pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32_SFLOAT,
+                                            offsetof(Snow, position));
+        pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32_SFLOAT,
+                                            offsetof(Snow, size));
+        pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32_SFLOAT,
+                                            offsetof(Snow, alpha));
+        pipeline_settings.SetPrimitiveTopology(
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        pipeline_settings.depth_stencil_state_create_info->depthTestEnable =
+            VK_FALSE;
+        pipeline_settings.depth_stencil_state_create_info->depthWriteEnable =
+            VK_FALSE;
+
+        pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
+        pipeline_settings.SetBlendState(
+            0,
+            {VK_TRUE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+             VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE,
+             VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_OP_ADD,
+             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                 VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT});
 
-  IgnoreResult(Device()->CreatePipeline(pipeline_settings, &pipeline_));
+        IgnoreResult(CreateGraphicsPipeline(pipeline_settings, &pipeline_));
+      },
+      {vertex, fragment});
 
-  vulkan::PipelineSettings background_pipeline_settings(RenderPass(),
-                                                        pipeline_layout_.get());
-  background_pipeline_settings.AddShaderStage(background_vertex_shader_.get(),
-                                              VK_SHADER_STAGE_VERTEX_BIT);
-  background_pipeline_settings.AddShaderStage(background_fragment_shader_.get(),
-                                              VK_SHADER_STAGE_FRAGMENT_BIT);
-  background_pipeline_settings.SetPrimitiveTopology(
-      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-  background_pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
+  RunAtStartup(
+      [this]() {
+        vulkan::PipelineSettings background_pipeline_settings(
+            RenderPass(), pipeline_layout_.get());
+        background_pipeline_settings.AddShaderStage(
+            background_vertex_shader_.get(), VK_SHADER_STAGE_VERTEX_BIT);
+        background_pipeline_settings.AddShaderStage(
+            background_fragment_shader_.get(), VK_SHADER_STAGE_FRAGMENT_BIT);
+        background_pipeline_settings.SetPrimitiveTopology(
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        background_pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
 
-  IgnoreResult(Device()->CreatePipeline(background_pipeline_settings,
-                                        &background_pipeline_));
+        IgnoreResult(CreateGraphicsPipeline(background_pipeline_settings,
+                                            &background_pipeline_));
+      },
+      {background_vertex, background_fragment});
 }
 
 void SnowSystem::DestroyPipeline() {
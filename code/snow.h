@@ -22,13 +22,15 @@ struct SnowInfo {
 
 class SnowSystem : public Application {
  public:
-  SnowSystem();
+  explicit SnowSystem(const ApplicationSettings &settings = {});
 
  private:
   void OnInitImpl() override;
 
   void OnUpdateImpl() override;
 
+  void OnSnapshotImpl() override;
+
   void OnRenderImpl(VkCommandBuffer cmd_buffer) override;
 
   void OnShutdownImpl() override;
@@ -61,5 +63,11 @@ class SnowSystem : public Application {
   std::shared_ptr<vulkan::Pipeline> background_pipeline_;
 
   std::vector<SnowInfo> snow_infos_;
-  std::random_device rd_;
+  std::mt19937 random_;
+  float accumulated_time_{0.0f};
+  float generate_duration_{0.5f};
+  float duration_scalar_{3.0f};
+
+  std::vector<Snow> snows_;
+  uint32_t snow_count_{0};
 };
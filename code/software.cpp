@@ -0,0 +1,225 @@
+#include "celestial_bodies.h"
+#include "chrono"
+#include "fmt/format.h"
+#include "fstream"
+#include "host_utils.h"
+#include "lighting_scene.h"
+#include "memory"
+#include "software_rasterizer.h"
+#include "stdexcept"
+
+namespace {
+// A demo scene reduced to what the software rasterizer draws, without the
+// Vulkan resources or the window input.
+class SoftwareScene {
+ public:
+  virtual ~SoftwareScene() = default;
+
+  // Advances the scene to t seconds. Static scenes keep the draw calls
+  // their constructor filled in.
+  virtual void Update(float t) {
+  }
+
+  [[nodiscard]] SoftwareShading Shading() const {
+    return shading_;
+  }
+  [[nodiscard]] const SoftwareGlobals &Globals() const {
+    return globals_;
+  }
+  [[nodiscard]] const std::vector<SoftwareDrawCall> &DrawCalls() const {
+    return draw_calls_;
+  }
+
+ protected:
+  SoftwareShading shading_{SoftwareShading::kUnlit};
+  SoftwareGlobals globals_;
+  std::vector<SoftwareDrawCall> draw_calls_;
+};
+
+// Lighting's initial view: the smoothed model lit from its default light
+// direction and hue. Lighting only changes with input, so the scene is
+// static.
+class LightingScene : public SoftwareScene {
+ public:
+  explicit LightingScene(float aspect) {
+    mesh_ = LoadSmoothedMesh(ASSETS_PATH "meshes/eight.uniform.obj");
+    white_image_(0, 0) = {255, 255, 255, 255};
+    shading_ = SoftwareShading::kLit;
+
+    LightingGlobalUniformObject globals;
+    EntityUniformObject entity;
+    InitialLightingScene(aspect, &globals, &entity);
+    globals_.proj = globals.proj;
+    globals_.world = globals.world;
+    globals_.directional_light_direction = globals.directional_light_direction;
+    globals_.directional_light_color = globals.directional_light_color;
+    globals_.specular_color = globals.specular_light;
+    globals_.ambient_light_color = globals.ambient_light_color;
+    draw_calls_ = {{&mesh_, &white_image_, entity}};
+  }
+
+ private:
+  Mesh mesh_;
+  Image white_image_;
+};
+
+// SolarSystem's orbits seen from its initial camera, without the labels.
+class SolarSystemScene : public SoftwareScene {
+ public:
+  explicit SolarSystemScene(float aspect) {
+    globals_.proj = SolarSystemProjection(aspect);
+    globals_.world = SolarSystemView(0.0f);
+    sphere_ = CreateSphereMesh(30);
+    for (const auto &info : SolarSystemBodies()) {
+      textures_.emplace_back();
+      textures_.back().ReadFromFile(info.texture_path);
+    }
+  }
+
+  void Update(float t) override {
+    const auto &bodies = SolarSystemBodies();
+    std::vector<glm::mat4> world_transforms(bodies.size());
+    draw_calls_.clear();
+    for (size_t i = 0; i < bodies.size(); i++) {
+      glm::mat4 parent_world{1.0f};
+      if (bodies[i].parent >= 0) {
+        parent_world = world_transforms[bodies[i].parent];
+      }
+      glm::mat4 local_transform;
+      ComputeCelestialTransforms(bodies[i], parent_world, t,
+                                 &world_transforms[i], &local_transform);
+      EntityUniformObject entity{};
+      entity.model_ = world_transforms[i] * local_transform;
+      draw_calls_.push_back({&sphere_, &textures_[i], entity});
+    }
+  }
+
+ private:
+  Mesh sphere_;
+  std::vector<Image> textures_;
+};
+
+std::unique_ptr<SoftwareScene> CreateScene(const std::string &name,
+                                           float aspect) {
+  if (name == "lighting") {
+    return std::make_unique<LightingScene>(aspect);
+  } else if (name == "solar_system") {
+    return std::make_unique<SolarSystemScene>(aspect);
+  }
+  throw std::runtime_error("Unknown software demo: " + name);
+}
+}  // namespace
+
+// Renders the Lighting and SolarSystem scenes on the CPU for a fixed number
+// of frames and writes the per-stage timings as JSON, needing no Vulkan
+// device.
+int main(int argc, char **argv) {
+  uint32_t width = 1280;
+  uint32_t height = 720;
+  uint64_t frame_count = 300;
+  uint64_t warmup = 30;
+  double dt = 1.0 / 60.0;
+  size_t threads = 0;
+  uint64_t dump_interval = 0;
+  std::string dump_path = "software_{}_{:05}.png";
+  std::string output = "software.json";
+  std::vector<std::string> demos;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--demo") {
+      demos.push_back(next());
+    } else if (arg == "--width") {
+      width = std::stoul(next());
+    } else if (arg == "--height") {
+      height = std::stoul(next());
+    } else if (arg == "--frames") {
+      frame_count = std::stoull(next());
+    } else if (arg == "--warmup") {
+      warmup = std::stoull(next());
+    } else if (arg == "--dt") {
+      dt = std::stod(next());
+    } else if (arg == "--threads") {
+      threads = std::stoul(next());
+    } else if (arg == "--dump-interval") {
+      dump_interval = std::stoull(next());
+    } else if (arg == "--dump-path") {
+      dump_path = next();
+    } else if (arg == "--output") {
+      output = next();
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+  if (warmup >= frame_count) {
+    throw std::runtime_error("Warmup must be shorter than the run.");
+  }
+  if (demos.empty()) {
+    demos = {"lighting", "solar_system"};
+  }
+
+  SoftwareRasterizer rasterizer(width, height, threads);
+  float aspect = float(width) / float(height);
+  std::vector<std::string> results;
+  for (auto &demo : demos) {
+    fmt::print("Rendering {}...\n", demo);
+    auto scene = CreateScene(demo, aspect);
+    std::vector<double> frame_ms, update_ms, vertex_ms, binning_ms, raster_ms;
+    double total_ms = 0.0;
+    for (uint64_t frame = 0; frame < frame_count; frame++) {
+      auto start = std::chrono::steady_clock::now();
+      scene->Update(float(double(frame) * dt));
+      auto render_start = std::chrono::steady_clock::now();
+      rasterizer.Render(scene->Globals(), scene->Shading(),
+                        scene->DrawCalls());
+      auto end = std::chrono::steady_clock::now();
+      if (dump_interval && frame % dump_interval == 0) {
+        rasterizer.Frame().WriteToFile(fmt::format(dump_path, demo, frame));
+      }
+      if (frame < warmup) {
+        continue;
+      }
+      const SoftwareFrameStats &stats = rasterizer.Stats();
+      frame_ms.push_back(
+          std::chrono::duration<double, std::milli>(end - start).count());
+      update_ms.push_back(std::chrono::duration<double, std::milli>(
+                              render_start - start)
+                              .count());
+      vertex_ms.push_back(stats.vertex_ms);
+      binning_ms.push_back(stats.binning_ms);
+      raster_ms.push_back(stats.raster_ms);
+      total_ms += frame_ms.back();
+    }
+    double fps = total_ms > 0.0 ? double(frame_ms.size()) * 1000.0 / total_ms
+                                : 0.0;
+    results.push_back(fmt::format(
+        "    \"{}\": {{\n      \"frames\": {},\n      \"fps\": {:.2f},\n"
+        "      \"frame_ms\": {},\n      \"update_ms\": {},\n"
+        "      \"vertex_ms\": {},\n      \"binning_ms\": {},\n"
+        "      \"raster_ms\": {}\n    }}",
+        demo, frame_ms.size(), fps, SeriesToJson(frame_ms),
+        SeriesToJson(update_ms), SeriesToJson(vertex_ms),
+        SeriesToJson(binning_ms), SeriesToJson(raster_ms)));
+  }
+
+  std::string json = fmt::format(
+      "{{\n  \"frames\": {},\n  \"warmup\": {},\n  \"dt\": {},\n"
+      "  \"extent\": [{}, {}],\n  \"threads\": {},\n  \"demos\": {{\n",
+      frame_count, warmup, dt, width, height, threads);
+  for (size_t i = 0; i < results.size(); i++) {
+    json += results[i] + (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  json += "  }\n}\n";
+
+  std::ofstream file(output);
+  if (!file) {
+    throw std::runtime_error("Failed to open " + output);
+  }
+  file << json;
+  fmt::print("Wrote {}\n", output);
+}
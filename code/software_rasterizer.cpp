@@ -0,0 +1,460 @@
+#include "software_rasterizer.h"
+
+#include "algorithm"
+#include "chrono"
+#include "glm/gtc/matrix_transform.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include "emmintrin.h"
+#define SOFTWARE_RASTERIZER_SSE
+#endif
+
+namespace {
+constexpr uint32_t kTileSize = 64;
+// Below these sizes a batch costs more to hand to a worker than to run.
+constexpr size_t kMinVertexBatch = 1024;
+constexpr size_t kMinTriangleBatch = 256;
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Bilinear filtering with clamp to edge, like the entity sampler.
+glm::vec4 SampleTexture(const Image &texture, glm::vec2 tex_coord) {
+  float x = tex_coord.x * float(texture.Width()) - 0.5f;
+  float y = tex_coord.y * float(texture.Height()) - 0.5f;
+  float floor_x = std::floor(x);
+  float floor_y = std::floor(y);
+  int max_x = int(texture.Width()) - 1;
+  int max_y = int(texture.Height()) - 1;
+  auto fetch = [&](int px, int py) {
+    const ImagePixel &pixel =
+        texture(std::clamp(px, 0, max_x), std::clamp(py, 0, max_y));
+    return glm::vec4{pixel.r, pixel.g, pixel.b, pixel.a} / 255.0f;
+  };
+  int x0 = int(floor_x);
+  int y0 = int(floor_y);
+  float tx = x - floor_x;
+  float ty = y - floor_y;
+  return glm::mix(glm::mix(fetch(x0, y0), fetch(x0 + 1, y0), tx),
+                  glm::mix(fetch(x0, y0 + 1), fetch(x0 + 1, y0 + 1), tx), ty);
+}
+
+uint8_t ToUnorm(float value) {
+  return uint8_t(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+}  // namespace
+
+SoftwareRasterizer::SoftwareRasterizer(uint32_t width,
+                                       uint32_t height,
+                                       size_t thread_count)
+    : width_(width),
+      height_(height),
+      tiles_x_((width + kTileSize - 1) / kTileSize),
+      tiles_y_((height + kTileSize - 1) / kTileSize),
+      depth_stride_((width + 3) & ~3u),
+      frame_(width, height),
+      depth_(size_t((width + 3) & ~3u) * height) {
+  if (!thread_count) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (thread_count > 1) {
+    pool_ = std::make_unique<ThreadPool>(thread_count);
+  }
+}
+
+void SoftwareRasterizer::Render(
+    const SoftwareGlobals &globals,
+    SoftwareShading shading,
+    const std::vector<SoftwareDrawCall> &draw_calls) {
+  auto start = std::chrono::steady_clock::now();
+  globals_ = globals;
+  shading_ = shading;
+  eye_position_ = glm::vec3(glm::inverse(globals.world)[3]);
+
+  TransformVertices(draw_calls);
+  stats_.vertex_ms = MillisecondsSince(start);
+
+  auto binning_start = std::chrono::steady_clock::now();
+  BinTriangles(draw_calls);
+  stats_.binning_ms = MillisecondsSince(binning_start);
+
+  // Tiles differ a lot in cost, so workers pull them one at a time.
+  auto raster_start = std::chrono::steady_clock::now();
+  size_t tile_count = size_t(tiles_x_) * tiles_y_;
+  next_tile_ = 0;
+  ParallelFor(BatchCount(tile_count, 1), [&](size_t) {
+    for (size_t tile = next_tile_++; tile < tile_count; tile = next_tile_++) {
+      RasterizeTile(tile, draw_calls);
+    }
+  });
+  stats_.raster_ms = MillisecondsSince(raster_start);
+  stats_.total_ms = MillisecondsSince(start);
+}
+
+size_t SoftwareRasterizer::BatchCount(size_t count, size_t min_batch) const {
+  if (!pool_) {
+    return 1;
+  }
+  return std::clamp<size_t>(count / min_batch, 1, pool_->ThreadCount());
+}
+
+void SoftwareRasterizer::ParallelFor(size_t batch_count,
+                                     const std::function<void(size_t)> &fn) {
+  if (batch_count <= 1) {
+    fn(0);
+    return;
+  }
+  std::vector<std::future<void>> batches;
+  for (size_t batch = 0; batch < batch_count; batch++) {
+    batches.push_back(pool_->Submit([&fn, batch]() { fn(batch); }));
+  }
+  for (auto &batch : batches) {
+    batch.get();
+  }
+}
+
+void SoftwareRasterizer::TransformVertices(
+    const std::vector<SoftwareDrawCall> &draw_calls) {
+  vertex_offsets_.assign(1, 0);
+  std::vector<glm::mat3> normal_transforms;
+  // The shaders flip y after the projection.
+  glm::mat4 view_proj =
+      glm::scale(glm::mat4{1.0f}, glm::vec3{1.0f, -1.0f, 1.0f}) *
+      globals_.proj * globals_.world;
+  for (auto &draw_call : draw_calls) {
+    vertex_offsets_.push_back(vertex_offsets_.back() +
+                              draw_call.mesh->vertices.size());
+    normal_transforms.push_back(
+        glm::transpose(glm::inverse(glm::mat3(draw_call.entity.model_))));
+  }
+  vertices_.resize(vertex_offsets_.back());
+
+  size_t count = vertices_.size();
+  size_t batch_count = BatchCount(count, kMinVertexBatch);
+  ParallelFor(batch_count, [&](size_t batch) {
+    size_t begin = count * batch / batch_count;
+    size_t end = count * (batch + 1) / batch_count;
+    size_t draw = std::upper_bound(vertex_offsets_.begin(),
+                                   vertex_offsets_.end(), begin) -
+                  vertex_offsets_.begin() - 1;
+    for (size_t i = begin; i < end; i++) {
+      while (i >= vertex_offsets_[draw + 1]) {
+        draw++;
+      }
+      const auto &entity = draw_calls[draw].entity;
+      const Vertex &vertex =
+          draw_calls[draw].mesh->vertices[i - vertex_offsets_[draw]];
+      ShadedVertex &shaded = vertices_[i];
+      glm::vec4 pos = entity.model_ * glm::vec4{vertex.pos, 1.0f};
+      shaded.clip = view_proj * pos;
+      shaded.pos = glm::vec3(pos);
+      shaded.normal = glm::normalize(normal_transforms[draw] * vertex.normal);
+      shaded.color = vertex.color;
+      shaded.tex_coord = vertex.tex_coord;
+    }
+  });
+}
+
+void SoftwareRasterizer::BinTriangles(
+    const std::vector<SoftwareDrawCall> &draw_calls) {
+  std::vector<size_t> triangle_offsets(1, 0);
+  for (auto &draw_call : draw_calls) {
+    triangle_offsets.push_back(triangle_offsets.back() +
+                               draw_call.mesh->indices.size() / 3);
+  }
+
+  size_t count = triangle_offsets.back();
+  size_t batch_count = BatchCount(count, kMinTriangleBatch);
+  size_t tile_count = size_t(tiles_x_) * tiles_y_;
+  triangles_.resize(batch_count);
+  bins_.resize(batch_count);
+  for (size_t batch = 0; batch < batch_count; batch++) {
+    triangles_[batch].clear();
+    bins_[batch].resize(tile_count);
+    for (auto &bin : bins_[batch]) {
+      bin.clear();
+    }
+  }
+
+  auto lerp = [](const ShadedVertex &a, const ShadedVertex &b, float t) {
+    return ShadedVertex{glm::mix(a.clip, b.clip, t), glm::mix(a.pos, b.pos, t),
+                        glm::mix(a.normal, b.normal, t),
+                        glm::mix(a.color, b.color, t),
+                        glm::mix(a.tex_coord, b.tex_coord, t)};
+  };
+
+  ParallelFor(batch_count, [&](size_t batch) {
+    size_t begin = count * batch / batch_count;
+    size_t end = count * (batch + 1) / batch_count;
+    uint32_t draw = std::upper_bound(triangle_offsets.begin(),
+                                     triangle_offsets.end(), begin) -
+                    triangle_offsets.begin() - 1;
+    for (size_t i = begin; i < end; i++) {
+      while (i >= triangle_offsets[draw + 1]) {
+        draw++;
+      }
+      const auto &indices = draw_calls[draw].mesh->indices;
+      size_t first = (i - triangle_offsets[draw]) * 3;
+      const ShadedVertex *vertices = vertices_.data() + vertex_offsets_[draw];
+      ShadedVertex polygon[3] = {vertices[indices[first]],
+                                 vertices[indices[first + 1]],
+                                 vertices[indices[first + 2]]};
+
+      // Drop triangles entirely outside one plane of the clip volume.
+      uint32_t outside = ~0u;
+      for (auto &vertex : polygon) {
+        const glm::vec4 &clip = vertex.clip;
+        outside &= (clip.x < -clip.w ? 1u : 0u) | (clip.x > clip.w ? 2u : 0u) |
+                   (clip.y < -clip.w ? 4u : 0u) | (clip.y > clip.w ? 8u : 0u) |
+                   (clip.z < 0.0f ? 16u : 0u) | (clip.z > clip.w ? 32u : 0u);
+      }
+      if (outside) {
+        continue;
+      }
+
+      // Only the near plane is clipped, the far plane is left to the depth
+      // test and the sides to the screen bounds.
+      ShadedVertex clipped[4];
+      int clipped_count = 0;
+      for (int j = 0; j < 3; j++) {
+        const ShadedVertex &a = polygon[j];
+        const ShadedVertex &b = polygon[(j + 1) % 3];
+        if (a.clip.z >= 0.0f) {
+          clipped[clipped_count++] = a;
+        }
+        if ((a.clip.z >= 0.0f) != (b.clip.z >= 0.0f)) {
+          clipped[clipped_count++] =
+              lerp(a, b, a.clip.z / (a.clip.z - b.clip.z));
+        }
+      }
+      for (int j = 1; j + 1 < clipped_count; j++) {
+        SetupTriangle(clipped[0], clipped[j], clipped[j + 1], draw, batch);
+      }
+    }
+  });
+}
+
+void SoftwareRasterizer::SetupTriangle(const ShadedVertex &v0,
+                                       const ShadedVertex &v1,
+                                       const ShadedVertex &v2,
+                                       uint32_t draw,
+                                       size_t batch) {
+  Triangle triangle{};
+  triangle.draw = draw;
+  triangle.vertices[0] = v0;
+  triangle.vertices[1] = v1;
+  triangle.vertices[2] = v2;
+
+  float x[3], y[3], z[3];
+  for (int i = 0; i < 3; i++) {
+    const glm::vec4 &clip = triangle.vertices[i].clip;
+    triangle.inv_w[i] = 1.0f / clip.w;
+    x[i] = (clip.x * triangle.inv_w[i] * 0.5f + 0.5f) * float(width_);
+    y[i] = (clip.y * triangle.inv_w[i] * 0.5f + 0.5f) * float(height_);
+    z[i] = clip.z * triangle.inv_w[i];
+  }
+
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (!(std::fabs(area) > 1e-8f)) {
+    return;
+  }
+  float inv_area = 1.0f / area;
+  for (int i = 0; i < 3; i++) {
+    int j = (i + 1) % 3;
+    int k = (i + 2) % 3;
+    triangle.edge_a[i] = (y[j] - y[k]) * inv_area;
+    triangle.edge_b[i] = (x[k] - x[j]) * inv_area;
+    triangle.edge_c[i] = (x[j] * y[k] - x[k] * y[j]) * inv_area;
+    // The weights grow towards the inside, so the inward normal of a left
+    // edge points right and that of a top edge points down.
+    triangle.top_left[i] =
+        triangle.edge_a[i] > 0.0f ||
+        (triangle.edge_a[i] == 0.0f && triangle.edge_b[i] > 0.0f);
+    triangle.depth_a += z[i] * triangle.edge_a[i];
+    triangle.depth_b += z[i] * triangle.edge_b[i];
+    triangle.depth_c += z[i] * triangle.edge_c[i];
+  }
+
+  // Pixels are sampled at their centers.
+  float min_x = std::min({x[0], x[1], x[2]});
+  float max_x = std::max({x[0], x[1], x[2]});
+  float min_y = std::min({y[0], y[1], y[2]});
+  float max_y = std::max({y[0], y[1], y[2]});
+  triangle.min_x = std::max(0, int(std::ceil(min_x - 0.5f)));
+  triangle.max_x = std::min(int(width_) - 1, int(std::floor(max_x - 0.5f)));
+  triangle.min_y = std::max(0, int(std::ceil(min_y - 0.5f)));
+  triangle.max_y = std::min(int(height_) - 1, int(std::floor(max_y - 0.5f)));
+  if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+    return;
+  }
+
+  auto &triangles = triangles_[batch];
+  auto &bins = bins_[batch];
+  uint32_t index = triangles.size();
+  triangles.push_back(triangle);
+  for (uint32_t tile_y = triangle.min_y / kTileSize;
+       tile_y <= triangle.max_y / kTileSize; tile_y++) {
+    for (uint32_t tile_x = triangle.min_x / kTileSize;
+         tile_x <= triangle.max_x / kTileSize; tile_x++) {
+      bins[tile_y * tiles_x_ + tile_x].push_back(index);
+    }
+  }
+}
+
+void SoftwareRasterizer::RasterizeTile(
+    size_t tile,
+    const std::vector<SoftwareDrawCall> &draw_calls) {
+  int tile_x0 = int(tile % tiles_x_ * kTileSize);
+  int tile_y0 = int(tile / tiles_x_ * kTileSize);
+  int tile_x1 = std::min(tile_x0 + int(kTileSize), int(width_)) - 1;
+  int tile_y1 = std::min(tile_y0 + int(kTileSize), int(height_)) - 1;
+
+  for (int y = tile_y0; y <= tile_y1; y++) {
+    float *depth_row = depth_.data() + size_t(y) * depth_stride_;
+    std::fill(depth_row + tile_x0,
+              depth_row + std::min<int>(tile_x0 + kTileSize, depth_stride_),
+              1.0f);
+    std::fill(&frame_(tile_x0, y), &frame_(tile_x1, y) + 1,
+              ImagePixel{0, 0, 0, 255});
+  }
+
+  for (size_t batch = 0; batch < triangles_.size(); batch++) {
+    for (uint32_t index : bins_[batch][tile]) {
+      const Triangle &triangle = triangles_[batch][index];
+      const SoftwareDrawCall &draw_call = draw_calls[triangle.draw];
+      // Quads start on a multiple of four, which tiles also do.
+      int x0 = std::max(triangle.min_x, tile_x0) & ~3;
+      int x1 = std::min(triangle.max_x, tile_x1);
+      int y0 = std::max(triangle.min_y, tile_y0);
+      int y1 = std::min(triangle.max_y, tile_y1);
+      for (int y = y0; y <= y1; y++) {
+        float center_y = float(y) + 0.5f;
+        float *depth_row = depth_.data() + size_t(y) * depth_stride_;
+        for (int x = x0; x <= x1; x += 4) {
+          int covered = CoverQuad(triangle, x, center_y,
+                                  std::min(4, x1 - x + 1), depth_row + x);
+          for (int lane = 0; lane < 4; lane++) {
+            if (!(covered & (1 << lane))) {
+              continue;
+            }
+            glm::vec4 color = ShadePixel(triangle, draw_call,
+                                         float(x + lane) + 0.5f, center_y);
+            frame_(x + lane, y) = {ToUnorm(color.r), ToUnorm(color.g),
+                                   ToUnorm(color.b), ToUnorm(color.a)};
+          }
+        }
+      }
+    }
+  }
+}
+
+int SoftwareRasterizer::CoverQuad(const Triangle &triangle,
+                                  int x,
+                                  float y,
+                                  int lanes,
+                                  float *depth) {
+#ifdef SOFTWARE_RASTERIZER_SSE
+  const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), lane_offsets);
+  __m128 py = _mm_set1_ps(y);
+  __m128 zero = _mm_setzero_ps();
+  __m128 inside = _mm_cmplt_ps(lane_offsets, _mm_set1_ps(float(lanes)));
+  for (int i = 0; i < 3; i++) {
+    __m128 weight = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[i]), px),
+                   _mm_mul_ps(_mm_set1_ps(triangle.edge_b[i]), py)),
+        _mm_set1_ps(triangle.edge_c[i]));
+    __m128 on_edge = _mm_cmpeq_ps(weight, zero);
+    if (!triangle.top_left[i]) {
+      on_edge = zero;
+    }
+    inside = _mm_and_ps(inside,
+                        _mm_or_ps(_mm_cmpgt_ps(weight, zero), on_edge));
+  }
+  if (!_mm_movemask_ps(inside)) {
+    return 0;
+  }
+  __m128 z = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth_a), px),
+                 _mm_mul_ps(_mm_set1_ps(triangle.depth_b), py)),
+      _mm_set1_ps(triangle.depth_c));
+  __m128 old_z = _mm_loadu_ps(depth);
+  __m128 pass = _mm_and_ps(
+      inside, _mm_and_ps(_mm_cmplt_ps(z, old_z),
+                         _mm_cmple_ps(z, _mm_set1_ps(1.0f))));
+  _mm_storeu_ps(depth,
+                _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old_z)));
+  return _mm_movemask_ps(pass);
+#else
+  int covered = 0;
+  float py = y;
+  for (int lane = 0; lane < lanes; lane++) {
+    float px = float(x + lane) + 0.5f;
+    bool inside = true;
+    for (int i = 0; i < 3; i++) {
+      float weight = triangle.edge_a[i] * px + triangle.edge_b[i] * py +
+                     triangle.edge_c[i];
+      inside = inside &&
+               (weight > 0.0f || (weight == 0.0f && triangle.top_left[i]));
+    }
+    float z = triangle.depth_a * px + triangle.depth_b * py + triangle.depth_c;
+    if (inside && z < depth[lane] && z <= 1.0f) {
+      depth[lane] = z;
+      covered |= 1 << lane;
+    }
+  }
+  return covered;
+#endif
+}
+
+glm::vec4 SoftwareRasterizer::ShadePixel(const Triangle &triangle,
+                                         const SoftwareDrawCall &draw_call,
+                                         float x,
+                                         float y) const {
+  // Perspective correct weights from the screen space ones.
+  float weights[3];
+  float sum = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    weights[i] = (triangle.edge_a[i] * x + triangle.edge_b[i] * y +
+                  triangle.edge_c[i]) *
+                 triangle.inv_w[i];
+    sum += weights[i];
+  }
+  glm::vec3 pos{0.0f};
+  glm::vec3 normal{0.0f};
+  glm::vec3 color{0.0f};
+  glm::vec2 tex_coord{0.0f};
+  for (int i = 0; i < 3; i++) {
+    const ShadedVertex &vertex = triangle.vertices[i];
+    float weight = weights[i] / sum;
+    pos += vertex.pos * weight;
+    normal += vertex.normal * weight;
+    color += vertex.color * weight;
+    tex_coord += vertex.tex_coord * weight;
+  }
+
+  glm::vec4 texel = SampleTexture(*draw_call.texture, tex_coord);
+  if (shading_ == SoftwareShading::kUnlit) {
+    return glm::vec4{color, 1.0f} * texel;
+  }
+
+  glm::vec3 light_dir = glm::vec3(globals_.directional_light_direction);
+  normal = glm::normalize(normal);
+  glm::vec4 light_strength =
+      std::max(glm::dot(normal, light_dir), 0.0f) *
+          globals_.directional_light_color +
+      globals_.ambient_light_color;
+  light_strength.a = 1.0f;
+  glm::vec4 out_color = draw_call.entity.color_ * glm::vec4{color, 1.0f} *
+                        texel * light_strength;
+  glm::vec3 view_dir = glm::normalize(eye_position_ - pos);
+  glm::vec3 reflect_dir = glm::reflect(-light_dir, normal);
+  out_color += std::pow(std::max(glm::dot(view_dir, reflect_dir), 0.0f),
+                        32.0f) *
+               globals_.specular_color;
+  out_color.a = 1.0f;
+  return out_color;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include "atomic"
+#include "entity_uniform.h"
+#include "image.h"
+#include "memory"
+#include "mesh.h"
+#include "thread_pool.h"
+
+enum class SoftwareShading {
+  // entity.frag, vertex color times texture.
+  kUnlit,
+  // lighting.frag, adds a directional light with ambient and specular terms.
+  kLit,
+};
+
+// Same layout as LightingGlobalUniformObject, unlit scenes only use the
+// matrices.
+struct SoftwareGlobals {
+  glm::mat4 proj{1.0f};
+  glm::mat4 world{1.0f};
+  glm::vec4 directional_light_direction{0.0f};
+  glm::vec4 directional_light_color{0.0f};
+  glm::vec4 specular_color{0.0f};
+  glm::vec4 ambient_light_color{0.0f};
+};
+
+struct SoftwareDrawCall {
+  const Mesh *mesh;
+  const Image *texture;
+  EntityUniformObject entity;
+};
+
+struct SoftwareFrameStats {
+  double vertex_ms{};
+  double binning_ms{};
+  double raster_ms{};
+  double total_ms{};
+};
+
+// Draws the same scenes as the entity pipelines on the CPU. Vertices are
+// transformed in parallel, triangles are clipped against the near plane and
+// binned into screen tiles, then every tile is rasterized by one worker,
+// four pixels at a time with SSE where available.
+class SoftwareRasterizer {
+ public:
+  // thread_count 0 uses every hardware thread.
+  SoftwareRasterizer(uint32_t width, uint32_t height, size_t thread_count);
+
+  // Clears the frame and draws the calls in order, with a LESS depth test and
+  // no culling like the entity pipelines.
+  void Render(const SoftwareGlobals &globals,
+              SoftwareShading shading,
+              const std::vector<SoftwareDrawCall> &draw_calls);
+
+  [[nodiscard]] const Image &Frame() const {
+    return frame_;
+  }
+
+  [[nodiscard]] const SoftwareFrameStats &Stats() const {
+    return stats_;
+  }
+
+ private:
+  struct ShadedVertex {
+    glm::vec4 clip;
+    glm::vec3 pos;
+    glm::vec3 normal;
+    glm::vec3 color;
+    glm::vec2 tex_coord;
+  };
+
+  struct Triangle {
+    // Edge functions in screen space, scaled so that edge i evaluates to the
+    // barycentric weight of vertex i.
+    float edge_a[3];
+    float edge_b[3];
+    float edge_c[3];
+    // Edges on the top or left of the triangle own the pixels they cross.
+    bool top_left[3];
+    // Screen space depth plane.
+    float depth_a;
+    float depth_b;
+    float depth_c;
+    float inv_w[3];
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+    uint32_t draw;
+    ShadedVertex vertices[3];
+  };
+
+  // Number of batches to split count items into, at least min_batch items
+  // each and no more than there are workers.
+  [[nodiscard]] size_t BatchCount(size_t count, size_t min_batch) const;
+  // Runs fn for every batch index on the workers and waits for all of them.
+  void ParallelFor(size_t batch_count, const std::function<void(size_t)> &fn);
+
+  void TransformVertices(const std::vector<SoftwareDrawCall> &draw_calls);
+  void BinTriangles(const std::vector<SoftwareDrawCall> &draw_calls);
+  void SetupTriangle(const ShadedVertex &v0,
+                     const ShadedVertex &v1,
+                     const ShadedVertex &v2,
+                     uint32_t draw,
+                     size_t batch);
+  void RasterizeTile(size_t tile,
+                     const std::vector<SoftwareDrawCall> &draw_calls);
+  // Tests the first lanes of the four pixels starting at x against the
+  // triangle and the depth buffer and writes the depth of the covered ones.
+  // Returns the covered lanes as a bit mask.
+  static int CoverQuad(const Triangle &triangle,
+                       int x,
+                       float y,
+                       int lanes,
+                       float *depth);
+  glm::vec4 ShadePixel(const Triangle &triangle,
+                       const SoftwareDrawCall &draw_call,
+                       float x,
+                       float y) const;
+
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t tiles_x_;
+  uint32_t tiles_y_;
+  // Depth rows are padded to a multiple of four pixels so quads never cross
+  // the end of a row.
+  uint32_t depth_stride_;
+  std::unique_ptr<ThreadPool> pool_;
+
+  Image frame_;
+  std::vector<float> depth_;
+
+  SoftwareGlobals globals_;
+  SoftwareShading shading_{SoftwareShading::kUnlit};
+  glm::vec3 eye_position_{0.0f};
+
+  std::vector<size_t> vertex_offsets_;
+  std::vector<ShadedVertex> vertices_;
+  // Binning batches, each owning the triangles of a contiguous primitive
+  // range and a per-tile list of them, so rasterizing batches in order
+  // keeps the submission order.
+  std::vector<std::vector<Triangle>> triangles_;
+  std::vector<std::vector<std::vector<uint32_t>>> bins_;
+  std::atomic<size_t> next_tile_{0};
+
+  SoftwareFrameStats stats_;
+};
@@ -1,10 +1,7 @@
 #include "solar_system.h"
 
 #include "celestial_body.h"
-
-namespace {
-#include "built_in_shaders.inl"
-}
+#include "mesh.h"
 
 void SolarSystem::OnInitImpl() {
   CreateGlobalAssets();
@@ -29,38 +26,37 @@ void SolarSystem::OnShutdownImpl() {
   }
 
 void SolarSystem::OnUpdateImpl() {
-  static auto last_time = std::chrono::steady_clock::now();
-  auto current_time = std::chrono::steady_clock::now();
-  float delta_t =
-      std::chrono::duration<float>(current_time - last_time).count();
-  last_time = current_time;
-
-  font_factory_->ClearDrawCalls();
-  auto extent = Swapchain()->Extent();
-  float aspect = extent.width / static_cast<float>(extent.height);
-  global_uniform_object_.proj =
-      glm::perspective(glm::radians(45.0f), aspect, 0.1f, 40.0f);
-
+  // Planets never stop orbiting.
+  MarkDirty();
+  float delta_t = DeltaTime();
   float camera_angular_speed = glm::radians(90.0f);
-  if (glfwGetKey(Window(), GLFW_KEY_A)) {
-    camera_theta_ += camera_angular_speed * delta_t;
-  }
-  if (glfwGetKey(Window(), GLFW_KEY_D)) {
-    camera_theta_ -= camera_angular_speed * delta_t;
+  for (uint32_t step = 0; step < SimulationSteps(); step++) {
+    float last_camera_theta = camera_theta_;
+    float last_global_t = global_t_;
+    if (GetKey(GLFW_KEY_A)) {
+      camera_theta_ += camera_angular_speed * delta_t;
+    }
+    if (GetKey(GLFW_KEY_D)) {
+      camera_theta_ -= camera_angular_speed * delta_t;
+    }
+    global_t_ += delta_t * time_flowing_ratio_;
+    last_step_camera_theta_ = camera_theta_ - last_camera_theta;
+    last_step_t_ = global_t_ - last_global_t;
   }
 
-  float sin_camera_theta = std::sin(camera_theta_);
-  float cos_camera_theta = std::cos(camera_theta_);
-
-  global_uniform_object_.world = glm::lookAt(
-      glm::vec3{sin_camera_theta * 15.0f, 0.0f, cos_camera_theta * 15.0f},
-      glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
-  global_uniform_buffer_->At(0) = global_uniform_object_;
+  // Orbits are analytic in t, so interpolating t interpolates every body.
+  float rewind = 1.0f - InterpolationAlpha();
+  float camera_theta = camera_theta_ - rewind * last_step_camera_theta_;
+  float t = global_t_ - rewind * last_step_t_;
 
-  global_t_ += delta_t * time_flowing_ratio_;
+  font_factory_->ClearDrawCalls();
+  auto extent = FrameExtent();
+  float aspect = extent.width / static_cast<float>(extent.height);
+  global_uniform_object_.proj = SolarSystemProjection(aspect);
+  global_uniform_object_.world = SolarSystemView(camera_theta);
 
   for (auto planet : planets_) {
-    planet->Update(global_t_);
+    planet->Update(t);
   }
 
   if (show_planet_name_) {
@@ -109,24 +105,33 @@ void SolarSystem::OnUpdateImpl() {
                             "Use A/D to rotate camera.",
                             glm::vec3{1.0f, 1.0f, 1.0f}, 0.0f);
   }
+}
 
+void SolarSystem::OnSnapshotImpl() {
+  global_uniform_buffer_->At(0) = global_uniform_object_;
+  for (auto planet : planets_) {
+    planet->Sync();
+  }
   font_factory_->CompileFontDrawCalls();
 }
 
 void SolarSystem::OnRenderImpl(VkCommandBuffer cmd_buffer) {
-  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    entity_pipeline_->Handle());
-
-  VkDescriptorSet descriptor_sets[] = {
-      global_descriptor_sets_[CurrentFrame()]->Handle()};
-  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          entity_pipeline_layout_->Handle(), 0, 1,
-                          descriptor_sets, 0, nullptr);
-
-  //  triangle_entity_->Render(cmd_buffer, entity_pipeline_layout_->Handle());
-  for (auto planet : planets_) {
-    planet->Render(cmd_buffer);
-  }
+  cmd_buffer = RecordInParallel(
+      cmd_buffer, planets_.size(),
+      [this](VkCommandBuffer cmd_buffer, size_t begin, size_t end) {
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          entity_pipeline_->Handle());
+
+        VkDescriptorSet descriptor_sets[] = {
+            global_descriptor_sets_[CurrentFrame()]->Handle()};
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                entity_pipeline_layout_->Handle(), 0, 1,
+                                descriptor_sets, 0, nullptr);
+
+        for (size_t i = begin; i < end; i++) {
+          planets_[i]->Render(cmd_buffer);
+        }
+      });
 
   font_factory_->Render(cmd_buffer);
 }
@@ -136,34 +141,37 @@ void SolarSystem::CreateEntityPipelineAssets() {
       Device()->CreatePipelineLayout({global_descriptor_set_layout_->Handle(),
                                       EntityDescriptorSetLayout()->Handle()},
                                      &entity_pipeline_layout_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/entity.vert"),
-                                 VK_SHADER_STAGE_VERTEX_BIT),
-      &entity_vert_shader_));
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/entity.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &entity_frag_shader_));
-
-  vulkan::PipelineSettings pipeline_settings(RenderPass(),
-                                             entity_pipeline_layout_.get(), 0);
-  pipeline_settings.AddInputBinding(0, sizeof(Vertex),
-                                    VK_VERTEX_INPUT_RATE_VERTEX);
-  pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32B32_SFLOAT,
-                                      offsetof(Vertex, pos));
-  pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32G32B32_SFLOAT,
-                                      offsetof(Vertex, normal));
-  pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32G32B32_SFLOAT,
-                                      offsetof(Vertex, color));
-  pipeline_settings.AddInputAttribute(0, 3, VK_FORMAT_R32G32_SFLOAT,
-                                      offsetof(Vertex, tex_coord));
-  pipeline_settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-  pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
-  pipeline_settings.AddShaderStage(entity_vert_shader_.get(),
-                                   VK_SHADER_STAGE_VERTEX_BIT);
-  pipeline_settings.AddShaderStage(entity_frag_shader_.get(),
-                                   VK_SHADER_STAGE_FRAGMENT_BIT);
-  IgnoreResult(Device()->CreatePipeline(pipeline_settings, &entity_pipeline_));
+  StartupTask vertex = CreateShaderModuleAsync(
+      "shaders/entity.vert", VK_SHADER_STAGE_VERTEX_BIT, &entity_vert_shader_);
+  StartupTask fragment = CreateShaderModuleAsync(
+      "shaders/entity.frag", VK_SHADER_STAGE_FRAGMENT_BIT,
+      &entity_frag_shader_);
+
+  RunAtStartup(
+      [this]() {
+        vulkan::PipelineSettings pipeline_settings(
+            RenderPass(), entity_pipeline_layout_.get(), 0);
+        pipeline_settings.AddInputBinding(0, sizeof(Vertex),
+                                          VK_VERTEX_INPUT_RATE_VERTEX);
+        pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32B32_SFLOAT,
+                                            offsetof(Vertex, pos));
+        pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32G32B32_SFLOAT,
+                                            offsetof(Vertex, normal));
+        pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32G32B32_SFLOAT,
+                                            offsetof(Vertex, color));
+        pipeline_settings.AddInputAttribute(0, 3, VK_FORMAT_R32G32_SFLOAT,
+                                            offsetof(Vertex, tex_coord));
+        pipeline_settings.SetPrimitiveTopology(
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
+        pipeline_settings.AddShaderStage(entity_vert_shader_.get(),
+                                         VK_SHADER_STAGE_VERTEX_BIT);
+        pipeline_settings.AddShaderStage(entity_frag_shader_.get(),
+                                         VK_SHADER_STAGE_FRAGMENT_BIT);
+        IgnoreResult(
+            CreateGraphicsPipeline(pipeline_settings, &entity_pipeline_));
+      },
+      {vertex, fragment});
 }
 
 void SolarSystem::DestroyEntityPipelineAssets() {
@@ -194,42 +202,16 @@ void SolarSystem::CreateEntities() {
   Image image;
   image.ReadFromFile(ASSETS_PATH "texture/earth.jpg");
 
-  triangle_ = std::make_unique<Model>(this, vertices, indices);
-  triangle_texture_image_ = std::make_unique<TextureImage>(this, image);
+  triangle_ =
+      std::make_unique<Model>(this, vertices, indices, StartupUploads());
+  triangle_texture_image_ =
+      std::make_unique<TextureImage>(this, image, StartupUploads());
   triangle_entity_ = std::make_unique<Entity>(this, triangle_.get(),
                                               triangle_texture_image_.get());
 
-  const int precision = 30;
-  const float inv_precision = 1.0f / float(precision);
-  std::vector<Vertex> sphere_vertices;
-  std::vector<uint32_t> sphere_indices;
-
-  for (int i = 0; i <= precision; i++) {
-    float phi = glm::pi<float>() * float(i) * inv_precision;
-    for (int j = 0; j < precision + 1; j++) {
-      float theta = 2.0f * glm::pi<float>() * float(j) * inv_precision;
-      glm::vec3 pos = glm::vec3{glm::cos(theta) * glm::sin(phi), glm::cos(phi),
-                                -glm::sin(theta) * glm::sin(phi)};
-      glm::vec3 normal = glm::normalize(pos);
-      glm::vec3 color = glm::vec3{1.0f, 1.0f, 1.0f};
-      glm::vec2 tex_coord =
-          glm::vec2{float(j) * inv_precision, float(i) * inv_precision};
-      sphere_vertices.push_back({pos, normal, color, tex_coord});
-
-      if (i && j) {
-        int i1 = i - 1;
-        int j1 = j - 1;
-        sphere_indices.push_back(i1 * (precision + 1) + j);
-        sphere_indices.push_back(i1 * (precision + 1) + j1);
-        sphere_indices.push_back(i * (precision + 1) + j);
-        sphere_indices.push_back(i1 * (precision + 1) + j1);
-        sphere_indices.push_back(i * (precision + 1) + j1);
-        sphere_indices.push_back(i * (precision + 1) + j);
-      }
-    }
-  }
-
-  sphere_ = std::make_unique<Model>(this, sphere_vertices, sphere_indices);
+  Mesh sphere = CreateSphereMesh(30);
+  sphere_ = std::make_unique<Model>(this, sphere.vertices, sphere.indices,
+                                    StartupUploads());
 }
 
 void SolarSystem::DestroyEntities() {
@@ -301,58 +283,30 @@ void SolarSystem::DestroyFontFactory() {
 }
 
 void SolarSystem::CreateCelestialBodies() {
-  // clang-format off
-  sun_ = std::make_unique<CelestialBody>(this, nullptr, 1.2f, 0.0f, 365.0f / 25.0f, 0.0f, 0.0f, 0.0f, ASSETS_PATH "texture/sun.jpg", "Sun");
-  mercury_ = std::make_unique<CelestialBody>(this, nullptr, 0.05f, 1.35f, 1.0f / 58.6462f, 365.2564f / 87.9674f, 0.0f, 100.0f, ASSETS_PATH "texture/mercury.jpg", "Mercury");
-  venus_ = std::make_unique<CelestialBody>(this, nullptr, 0.16f, 1.6f, 1.0f / 243.0187f, 365.2564f / 224.6960f, 0.0f, 200.0f, ASSETS_PATH "texture/venus.jpg", "Venus");
-  earth_ = std::make_unique<CelestialBody>(this, nullptr, 0.18f, 2.0f, 1.0f, 365.2564f / 365.2564f, 0.0f, 300.0f, ASSETS_PATH "texture/earth.jpg", "Earth");
-  mars_ = std::make_unique<CelestialBody>(this, nullptr, 0.1f, 2.4f, 23.9345f / 24.6230, 365.2564f / 686.9649, 0.0f, 400.0f, ASSETS_PATH "texture/mars.jpg", "Mars");
-  jupiter_ = std::make_unique<CelestialBody>(this, nullptr, 0.8f, 3.4f, 23.9345f / 9.9250f, 3.0f / 11.862615, 0.0f, 800.0f, ASSETS_PATH "texture/jupiter.jpg", "Jupiter");
-  saturn_ = std::make_unique<CelestialBody>(this, nullptr, 0.7f, 5.2f, 23.9345f / 10.6562f, 3.0f / 29.447498, 0.0f, 1600.0f, ASSETS_PATH "texture/saturn.jpg", "Saturn");
-  uranus_ = std::make_unique<CelestialBody>(this, nullptr, 0.6f, 6.7f, 23.9345f / 17.2399f, 3.0f / 84.016846, 0.0f, 2200.0f, ASSETS_PATH "texture/uranus.jpg", "Uranus");
-  neptune_ = std::make_unique<CelestialBody>(this, nullptr, 0.55f, 8.2f, 23.9345f / 16.1100f, 3.0f / 164.79132, 0.0f, 3000.0f, ASSETS_PATH "texture/neptune.jpg", "Neptune");
-  moon_ = std::make_unique<CelestialBody>(this, earth_.get(), 0.03f, 0.2f, -12.0f, 12.0f, 0.0f, 0.0f, ASSETS_PATH "texture/moon.jpg", "Moon");
-  // clang-format on
-
-  planets_.push_back(sun_.get());
-  planets_.push_back(mercury_.get());
-  planets_.push_back(venus_.get());
-  planets_.push_back(earth_.get());
-  planets_.push_back(mars_.get());
-  planets_.push_back(jupiter_.get());
-  planets_.push_back(saturn_.get());
-  planets_.push_back(uranus_.get());
-  planets_.push_back(neptune_.get());
-  planets_.push_back(moon_.get());
+  for (const auto &info : SolarSystemBodies()) {
+    CelestialBody *parent =
+        info.parent < 0 ? nullptr : celestial_bodies_[info.parent].get();
+    celestial_bodies_.push_back(
+        std::make_unique<CelestialBody>(this, parent, info));
+    planets_.push_back(celestial_bodies_.back().get());
+  }
 }
 
 void SolarSystem::DestroyCelestialBodies() {
-  moon_.reset();
-  neptune_.reset();
-  uranus_.reset();
-  saturn_.reset();
-  jupiter_.reset();
-  mars_.reset();
-  earth_.reset();
-  venus_.reset();
-  mercury_.reset();
-  sun_.reset();
+  planets_.clear();
+  // Satellites go before the bodies they orbit.
+  while (!celestial_bodies_.empty()) {
+    celestial_bodies_.pop_back();
+  }
 }
 
-SolarSystem::SolarSystem() {
-  glfwSetWindowUserPointer(Window(), this);
-  glfwSetKeyCallback(Window(), [](GLFWwindow *window, int key, int scancode,
-                                  int action, int mods) {
-    auto app =
-        reinterpret_cast<SolarSystem *>(glfwGetWindowUserPointer(window));
-    app->KeyCallBack(key, scancode, action, mods);
-  });
-
+SolarSystem::SolarSystem(const ApplicationSettings &settings)
+    : Application(settings) {
   font_types_[0] = ASSETS_PATH "font/consola.ttf";
   font_types_[1] = ASSETS_PATH "font/georgia.ttf";
 }
 
-void SolarSystem::KeyCallBack(int key, int scancode, int action, int mods) {
+void SolarSystem::OnKeyImpl(int key, int scancode, int action, int mods) {
   if (action == GLFW_PRESS || action == GLFW_REPEAT) {
     if (key == GLFW_KEY_F) {
       font_select_ = (font_select_ + 1) % 2;
@@ -16,7 +16,7 @@ struct GlobalUniformObject {
 
 class SolarSystem : public Application {
  public:
-  SolarSystem();
+  explicit SolarSystem(const ApplicationSettings &settings = {});
   [[nodiscard]] Model *GetSphereModel() const {
     return sphere_.get();
   }
@@ -32,6 +32,7 @@ class SolarSystem : public Application {
  private:
   void OnInitImpl() override;
   void OnUpdateImpl() override;
+  void OnSnapshotImpl() override;
   void OnRenderImpl(VkCommandBuffer cmd_buffer) override;
   void OnShutdownImpl() override;
 
@@ -47,7 +48,7 @@ class SolarSystem : public Application {
   void DestroyFontFactory();
   void DestroyCelestialBodies();
 
-  void KeyCallBack(int key, int scancode, int action, int mods);
+  void OnKeyImpl(int key, int scancode, int action, int mods) override;
 
   std::shared_ptr<vulkan::DescriptorPool> descriptor_pool_;
   std::shared_ptr<vulkan::DescriptorSetLayout> descriptor_set_layout_;
@@ -71,16 +72,7 @@ class SolarSystem : public Application {
 
   GlobalUniformObject global_uniform_object_;
 
-  std::unique_ptr<class CelestialBody> sun_;
-  std::unique_ptr<class CelestialBody> mercury_;
-  std::unique_ptr<class CelestialBody> venus_;
-  std::unique_ptr<class CelestialBody> earth_;
-  std::unique_ptr<class CelestialBody> mars_;
-  std::unique_ptr<class CelestialBody> jupiter_;
-  std::unique_ptr<class CelestialBody> saturn_;
-  std::unique_ptr<class CelestialBody> uranus_;
-  std::unique_ptr<class CelestialBody> neptune_;
-  std::unique_ptr<class CelestialBody> moon_;
+  std::vector<std::unique_ptr<CelestialBody>> celestial_bodies_;
 
   std::vector<CelestialBody *> planets_;
 
@@ -90,6 +82,8 @@ class SolarSystem : public Application {
   int font_select_{0};
   float global_t_{0.0f};
   float camera_theta_{0.0f};
+  float last_step_t_{0.0f};
+  float last_step_camera_theta_{0.0f};
   float time_flowing_ratio_{1.0f};
   bool show_planet_name_{true};
   bool show_usage_info_{true};
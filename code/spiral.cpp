@@ -1,8 +1,6 @@
 #include "spiral.h"
 
 namespace {
-#include "built_in_shaders.inl"
-
 glm::vec3 hsv2rgb(const glm::vec3 &hsv) {
   float h = hsv.x * 360.0f;  // scale hue to [0, 360)
   float s = hsv.y;
@@ -34,7 +32,8 @@ glm::vec3 hsv2rgb(const glm::vec3 &hsv) {
 
 }  // namespace
 
-SpiralSystem::SpiralSystem() {
+SpiralSystem::SpiralSystem(const ApplicationSettings &settings)
+    : Application(settings) {
 }
 
 void SpiralSystem::OnInitImpl() {
@@ -50,41 +49,48 @@ void SpiralSystem::OnShutdownImpl() {
 }
 
 void SpiralSystem::OnUpdateImpl() {
-  static auto last_time = std::chrono::high_resolution_clock::now();
-  auto current_time = std::chrono::high_resolution_clock::now();
-  float duration_s = std::chrono::duration<float, std::chrono::seconds::period>(
-                         current_time - last_time)
-                         .count();
-  last_time = current_time;
-  static float accumulated_time = 0.0f;
-  static float phase_state = 0.0f;
-  accumulated_time += duration_s;
+  MarkDirty();
+  float delta_t = DeltaTime();
   const float generate_duration = 0.05f;
   const float time_speed = 0.1f;
-  while (accumulated_time >= generate_duration) {
-    accumulated_time -= generate_duration;
-    StarInfo star_info{};
-    phase_state += glm::radians(15.0f);
-    while (phase_state > glm::radians(360.0f)) {
-      phase_state -= glm::radians(360.0f);
+  for (uint32_t step = 0; step < SimulationSteps(); step++) {
+    accumulated_time_ += delta_t;
+    while (accumulated_time_ >= generate_duration) {
+      accumulated_time_ -= generate_duration;
+      StarInfo star_info{};
+      phase_state_ += glm::radians(15.0f);
+      while (phase_state_ > glm::radians(360.0f)) {
+        phase_state_ -= glm::radians(360.0f);
+      }
+      glm::vec3 hsv{phase_state_ / glm::radians(360.0f), 0.7f, 1.0f};
+      star_info.color = hsv2rgb(hsv);
+      star_info.phase = phase_state_;
+      star_info.life = accumulated_time_ * time_speed;
+      star_infos_.push_back(star_info);
     }
-    glm::vec3 hsv{phase_state / glm::radians(360.0f), 0.7f, 1.0f};
-    star_info.color = hsv2rgb(hsv);
-    star_info.phase = phase_state;
-    star_info.life = accumulated_time * time_speed;
-    star_infos_.push_back(star_info);
-  }
-  std::vector<Star> stars;
-  std::vector<StarInfo> new_star_infos;
-  for (auto &star_info : star_infos_) {
-    star_info.life += time_speed * duration_s;
-    if (star_info.life < 1.0f) {
-      stars.push_back(star_info.GetStar());
-      new_star_infos.push_back(star_info);
+    std::vector<StarInfo> new_star_infos;
+    for (auto &star_info : star_infos_) {
+      star_info.life += time_speed * delta_t;
+      if (star_info.life < 1.0f) {
+        new_star_infos.push_back(star_info);
+      }
     }
+    star_infos_ = new_star_infos;
+  }
+
+  // Step back by the part of the last step that has not been reached yet.
+  float rewind = (1.0f - InterpolationAlpha()) * time_speed * delta_t;
+  stars_.clear();
+  for (auto star_info : star_infos_) {
+    star_info.life = std::max(star_info.life - rewind, 0.0f);
+    stars_.push_back(star_info.GetStar());
   }
-  star_infos_ = new_star_infos;
-  std::memcpy(star_buffer_->Data(), stars.data(), sizeof(Star) * stars.size());
+}
+
+void SpiralSystem::OnSnapshotImpl() {
+  std::memcpy(star_buffer_->Data(0, stars_.size()), stars_.data(),
+              sizeof(Star) * stars_.size());
+  star_count_ = stars_.size();
 }
 
 void SpiralSystem::OnRenderImpl(VkCommandBuffer cmd_buffer) {
@@ -97,21 +103,19 @@ void SpiralSystem::OnRenderImpl(VkCommandBuffer cmd_buffer) {
                           nullptr);
   VkBuffer vertex_buffers[] = {star_buffer_->GetBuffer()->Handle()};
   vkCmdBindVertexBuffers(cmd_buffer, 0, 1, vertex_buffers, offsets);
-  vkCmdDraw(cmd_buffer, 6, star_infos_.size(), 0, 0);
+  vkCmdDraw(cmd_buffer, 6, star_count_, 0, 0);
 }
 
 void SpiralSystem::CreateAssets() {
-  Image star_image_host;
-  star_image_host.ReadFromFile(ASSETS_PATH "texture/Star.bmp");
-  star_image_ = std::make_shared<TextureImage>(this, star_image_host);
+  star_image_ = LoadTexture(ASSETS_PATH "texture/Star.bmp", StartupUploads());
 
   global_uniform_buffer_ = std::make_shared<StaticBuffer<glm::mat4>>(this, 1);
 
   star_buffer_ = std::make_shared<DynamicBuffer<Star>>(this, 1000);
-  auto extent = Swapchain()->Extent();
+  auto extent = FrameExtent();
   glm::mat4 transform = glm::mat4{1.0f};
   transform[0][0] = float(extent.height) / float(extent.width);
-  global_uniform_buffer_->Upload({transform});
+  global_uniform_buffer_->Upload({transform}, StartupUploads());
 }
 
 void SpiralSystem::DestroyAssets() {
@@ -196,52 +200,53 @@ void SpiralSystem::DestroyDescriptorAssets() {
 }
 
 void SpiralSystem::CreatePipeline() {
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/star.vert"),
-                                 VK_SHADER_STAGE_VERTEX_BIT),
-      &vertex_shader_));
-
-  IgnoreResult(Device()->CreateShaderModule(
-      vulkan::CompileGLSLToSPIRV(GetShaderCode("shaders/star.frag"),
-                                 VK_SHADER_STAGE_FRAGMENT_BIT),
-      &fragment_shader_));
+  StartupTask vertex = CreateShaderModuleAsync(
+      "shaders/star.vert", VK_SHADER_STAGE_VERTEX_BIT, &vertex_shader_);
+  StartupTask fragment = CreateShaderModuleAsync(
+      "shaders/star.frag", VK_SHADER_STAGE_FRAGMENT_BIT, &fragment_shader_);
 
   IgnoreResult(Device()->CreatePipelineLayout(
       {descriptor_set_layout_->Handle()}, &pipeline_layout_));
 
-  vulkan::PipelineSettings pipeline_settings(RenderPass(),
-                                             pipeline_layout_.get());
-  pipeline_settings.AddShaderStage(vertex_shader_.get(),
-                                   VK_SHADER_STAGE_VERTEX_BIT);
-  pipeline_settings.AddShaderStage(fragment_shader_.get(),
-                                   VK_SHADER_STAGE_FRAGMENT_BIT);
-  pipeline_settings.AddInputBinding(0, sizeof(Star),
-                                    VK_VERTEX_INPUT_RATE_INSTANCE);
-  pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32_SFLOAT,
-                                      offsetof(Star, position));
-  pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32_SFLOAT,
-                                      offsetof(Star, size));
-  pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32G32B32_SFLOAT,
-                                      offsetof(Star, color));
-
-  pipeline_settings.SetPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-  pipeline_settings.SetMultiSampleState(VK_SAMPLE_COUNT_1_BIT);
-  pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
-  pipeline_settings.SetBlendState(
-      0, {
-             VK_TRUE,
-             VK_BLEND_FACTOR_ONE,
-             VK_BLEND_FACTOR_ONE,
-             VK_BLEND_OP_ADD,
-             VK_BLEND_FACTOR_ONE,
-             VK_BLEND_FACTOR_ONE,
-             VK_BLEND_OP_ADD,
-             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                 VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-         });
-  pipeline_settings.depth_stencil_state_create_info->depthTestEnable = VK_FALSE;
-
-  IgnoreResult(Device()->CreatePipeline(pipeline_settings, &pipeline_));
+  RunAtStartup(
+      [this]() {
+        vulkan::PipelineSettings pipeline_settings(RenderPass(),
+                                                   pipeline_layout_.get());
+        pipeline_settings.AddShaderStage(vertex_shader_.get(),
+                                         VK_SHADER_STAGE_VERTEX_BIT);
+        pipeline_settings.AddShaderStage(fragment_shader_.get(),
+                                         VK_SHADER_STAGE_FRAGMENT_BIT);
+        pipeline_settings.AddInputBinding(0, sizeof(Star),
+                                          VK_VERTEX_INPUT_RATE_INSTANCE);
+        pipeline_settings.AddInputAttribute(0, 0, VK_FORMAT_R32G32_SFLOAT,
+                                            offsetof(Star, position));
+        pipeline_settings.AddInputAttribute(0, 1, VK_FORMAT_R32_SFLOAT,
+                                            offsetof(Star, size));
+        pipeline_settings.AddInputAttribute(0, 2, VK_FORMAT_R32G32B32_SFLOAT,
+                                            offsetof(Star, color));
+
+        pipeline_settings.SetPrimitiveTopology(
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        pipeline_settings.SetMultiSampleState(VK_SAMPLE_COUNT_1_BIT);
+        pipeline_settings.SetCullMode(VK_CULL_MODE_NONE);
+        pipeline_settings.SetBlendState(
+            0, {
+                   VK_TRUE,
+                   VK_BLEND_FACTOR_ONE,
+                   VK_BLEND_FACTOR_ONE,
+                   VK_BLEND_OP_ADD,
+                   VK_BLEND_FACTOR_ONE,
+                   VK_BLEND_FACTOR_ONE,
+                   VK_BLEND_OP_ADD,
+                   VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                       VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+               });
+        pipeline_settings.depth_stencil_state_create_info->depthTestEnable =
+            VK_FALSE;
+
+        IgnoreResult(CreateGraphicsPipeline(pipeline_settings, &pipeline_));
+      },
+      {vertex, fragment});
 }
 
 void SpiralSystem::DestroyPipeline() {
@@ -23,13 +23,15 @@ struct StarInfo {
 
 class SpiralSystem : public Application {
  public:
-  SpiralSystem();
+  explicit SpiralSystem(const ApplicationSettings &settings = {});
 
  private:
   void OnInitImpl() override;
 
   void OnUpdateImpl() override;
 
+  void OnSnapshotImpl() override;
+
   void OnRenderImpl(VkCommandBuffer cmd_buffer) override;
 
   void OnShutdownImpl() override;
@@ -56,4 +58,9 @@ class SpiralSystem : public Application {
   std::shared_ptr<vulkan::Pipeline> pipeline_;
 
   std::vector<StarInfo> star_infos_;
+  float accumulated_time_{0.0f};
+  float phase_state_{0.0f};
+
+  std::vector<Star> stars_;
+  uint32_t star_count_{0};
 };
@@ -4,13 +4,19 @@
 
 class TextureImage {
  public:
-  TextureImage(Application *app, const Image &image);
+  // The pixels are uploaded with batch, which the caller submits, or right
+  // away when it is null.
+  TextureImage(DeviceContext *context,
+               const Image &image,
+               UploadBatch *batch = nullptr);
+  TextureImage(Application *app,
+               const Image &image,
+               UploadBatch *batch = nullptr);
 
   [[nodiscard]] vulkan::Image *GetImage() const {
     return image_.get();
   }
 
  private:
-  Application *app_{};
   std::unique_ptr<vulkan::Image> image_;
 };
@@ -0,0 +1,42 @@
+#pragma once
+#include "condition_variable"
+#include "deque"
+#include "functional"
+#include "future"
+#include "mutex"
+#include "thread"
+#include "vector"
+
+// Fixed set of worker threads draining a FIFO task queue.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t thread_count);
+  ~ThreadPool();
+
+  [[nodiscard]] size_t ThreadCount() const {
+    return threads_.size();
+  }
+
+  template <class Fn>
+  std::future<std::invoke_result_t<Fn>> Submit(Fn &&fn) {
+    using Result = std::invoke_result_t<Fn>;
+    auto task =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+    auto future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace_back([task]() { (*task)(); });
+    }
+    condition_.notify_one();
+    return future;
+  }
+
+ private:
+  void WorkerLoop();
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+  bool stop_{false};
+};
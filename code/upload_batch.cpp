@@ -0,0 +1,163 @@
+#include "upload_batch.h"
+
+#include "algorithm"
+#include "cstring"
+#include "stdexcept"
+
+namespace {
+// Satisfies the texel size and optimal copy offset alignment of every
+// format the demos upload.
+constexpr VkDeviceSize kStagingAlignment = 16;
+}  // namespace
+
+UploadBatch::UploadBatch(DeviceContext *context, VkDeviceSize chunk_size)
+    : context_(context), chunk_size_(chunk_size) {
+}
+
+UploadBatch::~UploadBatch() {
+  Wait();
+  for (auto &chunk : chunks_) {
+    chunk->Unmap();
+  }
+  chunks_.clear();
+  fence_.reset();
+  command_buffer_.reset();
+  command_pool_.reset();
+}
+
+void UploadBatch::UploadBuffer(vulkan::Buffer *buffer,
+                               const void *data,
+                               VkDeviceSize size,
+                               VkDeviceSize offset) {
+  if (!size) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  VkBuffer staging_buffer;
+  VkBufferCopy region{};
+  region.srcOffset = Stage(data, size, &staging_buffer);
+  region.dstOffset = offset;
+  region.size = size;
+  vkCmdCopyBuffer(BeginRecording(), staging_buffer, buffer->Handle(), 1,
+                  &region);
+}
+
+void UploadBatch::UploadImage(vulkan::Image *image, const Image &pixels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  VkBuffer staging_buffer;
+  VkBufferImageCopy region{};
+  region.bufferOffset =
+      Stage(pixels.Data(),
+            pixels.Width() * pixels.Height() * sizeof(ImagePixel),
+            &staging_buffer);
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {uint32_t(pixels.Width()), uint32_t(pixels.Height()),
+                        1};
+
+  VkCommandBuffer cmd_buffer = BeginRecording();
+  vulkan::TransitImageLayout(
+      cmd_buffer, image->Handle(), VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_MEMORY_READ_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+  vkCmdCopyBufferToImage(cmd_buffer, staging_buffer, image->Handle(),
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  vulkan::TransitImageLayout(
+      cmd_buffer, image->Handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+void UploadBatch::Submit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (submitted_) {
+    return;
+  }
+  submitted_ = true;
+  if (!command_buffer_) {
+    return;
+  }
+  VkCommandBuffer cmd_buffer = command_buffer_->Handle();
+  if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record upload command buffer.");
+  }
+  if (context_->Device()->CreateFence(false, &fence_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create upload fence.");
+  }
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd_buffer;
+  if (vkQueueSubmit(context_->TransferQueue()->Handle(), 1, &submit_info,
+                    fence_->Handle()) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to submit upload command buffer.");
+  }
+}
+
+bool UploadBatch::Done() const {
+  if (!fence_) {
+    return submitted_;
+  }
+  return vkGetFenceStatus(context_->Device()->Handle(), fence_->Handle()) ==
+         VK_SUCCESS;
+}
+
+void UploadBatch::Wait() const {
+  if (!fence_) {
+    return;
+  }
+  VkFence fence = fence_->Handle();
+  vkWaitForFences(context_->Device()->Handle(), 1, &fence, VK_TRUE,
+                  UINT64_MAX);
+}
+
+VkDeviceSize UploadBatch::Stage(const void *data,
+                                VkDeviceSize size,
+                                VkBuffer *buffer) {
+  if (submitted_) {
+    throw std::runtime_error("Upload recorded into a submitted batch.");
+  }
+  chunk_offset_ = (chunk_offset_ + kStagingAlignment - 1) /
+                  kStagingAlignment * kStagingAlignment;
+  if (chunks_.empty() || chunk_offset_ + size > chunks_.back()->Size()) {
+    std::unique_ptr<vulkan::Buffer> chunk;
+    if (context_->Device()->CreateBuffer(
+            std::max(chunk_size_, size), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_ONLY, &chunk) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create upload staging buffer.");
+    }
+    chunk_data_ = reinterpret_cast<uint8_t *>(chunk->Map());
+    chunk_offset_ = 0;
+    chunks_.push_back(std::move(chunk));
+  }
+  std::memcpy(chunk_data_ + chunk_offset_, data, size);
+  *buffer = chunks_.back()->Handle();
+  VkDeviceSize offset = chunk_offset_;
+  chunk_offset_ += size;
+  upload_count_++;
+  staged_bytes_ += size;
+  return offset;
+}
+
+VkCommandBuffer UploadBatch::BeginRecording() {
+  if (command_buffer_) {
+    return command_buffer_->Handle();
+  }
+  if (context_->Device()->CreateCommandPool(
+          context_->Device()->PhysicalDevice().TransferFamilyIndex(),
+          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+          &command_pool_) != VK_SUCCESS ||
+      command_pool_->AllocateCommandBuffer(&command_buffer_) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create upload command buffer.");
+  }
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(command_buffer_->Handle(), &begin_info) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Failed to begin upload command buffer.");
+  }
+  return command_buffer_->Handle();
+}
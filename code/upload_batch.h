@@ -0,0 +1,62 @@
+#pragma once
+#include "device_context.h"
+#include "image.h"
+#include "mutex"
+
+// Buffer and image uploads recorded into one transfer command buffer, with
+// their data staged in a shared host visible arena, so loading many assets
+// costs a single submit. Recording is thread safe. Destinations have to
+// outlive the batch and must not be used by the GPU before it is done.
+class UploadBatch {
+ public:
+  static constexpr VkDeviceSize kDefaultChunkSize = 4 << 20;
+
+  // Staging chunks hold chunk_size bytes, larger uploads get a chunk of
+  // their own.
+  explicit UploadBatch(DeviceContext *context,
+                       VkDeviceSize chunk_size = kDefaultChunkSize);
+  // Waits for a submitted batch before freeing its staging memory.
+  ~UploadBatch();
+
+  void UploadBuffer(vulkan::Buffer *buffer,
+                    const void *data,
+                    VkDeviceSize size,
+                    VkDeviceSize offset = 0);
+  // Fills the whole image and leaves it in SHADER_READ_ONLY_OPTIMAL.
+  void UploadImage(vulkan::Image *image, const Image &pixels);
+
+  // Submits everything recorded so far with the batch's fence. Nothing can
+  // be recorded afterwards.
+  void Submit();
+  // Whether the submitted copies have finished, polls the fence.
+  [[nodiscard]] bool Done() const;
+  void Wait() const;
+
+  [[nodiscard]] size_t UploadCount() const {
+    return upload_count_;
+  }
+  [[nodiscard]] VkDeviceSize StagedBytes() const {
+    return staged_bytes_;
+  }
+
+ private:
+  // Copies size bytes into the arena and returns where they landed.
+  VkDeviceSize Stage(const void *data, VkDeviceSize size, VkBuffer *buffer);
+  VkCommandBuffer BeginRecording();
+
+  DeviceContext *context_;
+  VkDeviceSize chunk_size_;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<vulkan::Buffer>> chunks_;
+  uint8_t *chunk_data_{nullptr};
+  VkDeviceSize chunk_offset_{};
+
+  std::unique_ptr<vulkan::CommandPool> command_pool_;
+  std::shared_ptr<vulkan::CommandBuffer> command_buffer_;
+  std::shared_ptr<vulkan::Fence> fence_;
+  bool submitted_{false};
+
+  size_t upload_count_{};
+  VkDeviceSize staged_bytes_{};
+};
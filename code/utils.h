@@ -1,4 +1,6 @@
 #pragma once
+#include "filesystem"
+#include "host_utils.h"
 #include "long_march.h"
 #include "set"
 
@@ -16,4 +18,6 @@ class DynamicBuffer;
 
 class DynamicBufferBase;
 
+class DeviceContext;
+
 void IgnoreResult(VkResult result);
@@ -0,0 +1,9 @@
+#pragma once
+#include "glm/glm.hpp"
+
+struct Vertex {
+  glm::vec3 pos;
+  glm::vec3 normal;
+  glm::vec3 color;
+  glm::vec2 tex_coord;
+};